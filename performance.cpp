@@ -6,7 +6,9 @@
 /////////////////////////////////////////////////////////////////////////////////
 
 // include the required header
+#define WY_THREADS 1 // hash_tree on threads
 #include <wy.hpp>
+#include "wyhash.h" // The reference implementation, to compare with
 #include <benchmark/benchmark.h>
 #include <cstdint>
 #include <vector>
@@ -14,6 +16,8 @@
 #include <array>
 #include <random>
 #include <utility>
+#include <cmath>
+#include <memory_resource>
 
 // Random common
 static void std_mt19937_64(benchmark::State& _benchmark_state)
@@ -36,6 +40,35 @@ static void wy_rand_common(benchmark::State& _benchmark_state)
 	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
 }
 BENCHMARK(wy_rand_common);
+// Generators of short-lived tasks
+static void wy_rand_construct(benchmark::State& _benchmark_state)
+{
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::rand()();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_construct);
+static void wy_rand_thread_local(benchmark::State& _benchmark_state)
+{
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::thread_rand()();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_thread_local)->ThreadRange(1, 16)->UseRealTime();
+static void wy_rand_atomic(benchmark::State& _benchmark_state)
+{
+	static wy::atomic_rand shared_rand; // Create a shared pseudo-random generator
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += shared_rand();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_atomic)->ThreadRange(1, 16)->UseRealTime();
 
 // Random uniform [0, 1)
 static void wy_rand_uniform_0_1(benchmark::State& _benchmark_state)
@@ -73,6 +106,23 @@ static void wy_rand_uniform_0_k(benchmark::State& _benchmark_state)
 BENCHMARK(wy_rand_uniform_0_k);
 #endif
 
+// Random uniform [0, 1) by blocks
+static void wy_rand_fill_uniform_0_1(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::vector<double> values(4096);
+	double no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		r.fill_uniform(values);
+		no_op += values[0];
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * values.size());
+}
+BENCHMARK(wy_rand_fill_uniform_0_1);
+
 // Random gaussian [0, 1]
 static void wy_rand_gaussian_0_1(benchmark::State& _benchmark_state)
 {
@@ -95,6 +145,75 @@ static void wy_rand_gaussian_mean_std(benchmark::State& _benchmark_state)
 	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
 }
 BENCHMARK(wy_rand_gaussian_mean_std);
+// Exact distributions
+static void std_normal_distribution(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::normal_distribution<double> dist;
+	double no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += dist(r);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(std_normal_distribution);
+static void wy_rand_normal_0_1(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	double no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += r.normal_dist();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_normal_0_1);
+static void wy_rand_exponential(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	double no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += r.exponential_dist();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_exponential);
+static void wy_rand_poisson(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	double mean = static_cast<double>(_benchmark_state.range(0));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += r.poisson_dist(mean);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_poisson)->Arg(3)->Arg(100);
+static void wy_rand_uniform_0_k_unbiased(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += r.uniform_dist_unbiased(5000);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_rand_uniform_0_k_unbiased);
+// Random gaussian [0, 1] by blocks
+static void wy_rand_fill_gaussian_0_1(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::vector<double> values(4096);
+	double no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		r.fill_gaussian(values);
+		no_op += values[0];
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * values.size());
+}
+BENCHMARK(wy_rand_fill_gaussian_0_1);
 
 // Random stream
 static void wy_rand_stream(benchmark::State& _benchmark_state)
@@ -113,6 +232,199 @@ static void wy_rand_stream(benchmark::State& _benchmark_state)
 	_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * vector_length);
 }
 BENCHMARK(wy_rand_stream)->Range(16, 4096);
+template<class RAND> static void wy_rand_stream_lanes(benchmark::State& _benchmark_state)
+{
+	RAND r; // Create a pseudo-random generator
+	int64_t vector_length = _benchmark_state.range(0);
+	std::vector<uint8_t> vec(vector_length);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		r.generate_stream(std::span<uint8_t>(vec));
+		no_op += vec[0];
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * vector_length);
+}
+BENCHMARK(wy_rand_stream_lanes<wy::rand_x4>)->Range(16, 4096);
+BENCHMARK(wy_rand_stream_lanes<wy::rand_x8>)->Range(16, 4096);
+
+// Shuffle and sampling
+template<int MODE> static void shuffle_uint32(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::vector<uint32_t> values(static_cast<size_t>(_benchmark_state.range(0)));
+	for (uint32_t i = 0; i < values.size(); i++)
+		values[i] = i;
+	for (auto _ : _benchmark_state)
+	{
+		if constexpr (MODE == 0)
+			std::shuffle(values.begin(), values.end(), r);
+		else if constexpr (MODE == 1)
+			wy::shuffle(std::span<uint32_t>(values), r);
+		else
+			wy::shuffle(std::span<uint32_t>(values), r, 0);
+		benchmark::DoNotOptimize(values.data());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * values.size());
+}
+BENCHMARK(shuffle_uint32<0>)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);// std::shuffle
+BENCHMARK(shuffle_uint32<1>)->Arg(1 << 10)->Arg(1 << 20)->Arg(1 << 24);// wy::shuffle
+BENCHMARK(shuffle_uint32<2>)->Arg(1 << 20)->Arg(1 << 24)->UseRealTime();// wy::shuffle, all threads
+static void wy_sample(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::vector<uint32_t> values(1 << 24);
+	for (uint32_t i = 0; i < values.size(); i++)
+		values[i] = i;
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::sample(values, 1000, r)[0];
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * values.size());
+}
+BENCHMARK(wy_sample);
+static void wy_alias_table_fill(benchmark::State& _benchmark_state)
+{
+	wy::rand r; // Create a pseudo-random generator
+	std::vector<double> weights(static_cast<size_t>(_benchmark_state.range(0)));
+	for (double& w : weights) w = r.uniform_dist();
+	wy::alias_table table(weights);
+	std::vector<uint32_t> indexes(4096);
+	for (auto _ : _benchmark_state)
+	{
+		table.fill(std::span<uint32_t>(indexes), r);
+		benchmark::DoNotOptimize(indexes.data());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * indexes.size());
+}
+BENCHMARK(wy_alias_table_fill)->Arg(16)->Arg(1 << 20);
+
+// Hasher construction: generate the secret of a new seed, reuse a seed, or copy a stored secret
+template<int MODE> static void wy_hash_construct(benchmark::State& _benchmark_state)
+{
+	wy::secret s = wy::secret::from_seed(42);
+	uint64_t seed = 0;
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		if constexpr (MODE == 0) no_op += wy::hash<uint64_t>(++seed)(no_op);
+		if constexpr (MODE == 1) no_op += wy::hash<uint64_t>(seed)(no_op);
+		if constexpr (MODE == 2) no_op += wy::hash<uint64_t>(s)(no_op);
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_hash_construct<0>);// New seed each time
+BENCHMARK(wy_hash_construct<1>);// Same seed
+BENCHMARK(wy_hash_construct<2>);// wy::secret
+
+// Bucket index of a hash: division, multiply-high and exact modulo with a precomputed divisor
+template<int MODE> static void bucket_index(benchmark::State& _benchmark_state)
+{
+	const uint64_t n = 1000003;
+	wy::fastmod mod(n);
+	wy::hash<uint64_t> hasher;
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		uint64_t h = hasher(no_op);
+		benchmark::DoNotOptimize(n);
+		if constexpr (MODE == 0) no_op += h % n;
+		if constexpr (MODE == 1) no_op += wy::reduce(h, n);
+		if constexpr (MODE == 2) no_op += mod(h);
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(bucket_index<0>);// h % n
+BENCHMARK(bucket_index<1>);// wy::reduce
+BENCHMARK(bucket_index<2>);// wy::fastmod
+
+// Request-scoped temporary set: global heap or a reused arena
+template<bool ARENA> static void flat_set_temporary(benchmark::State& _benchmark_state)
+{
+	std::vector<std::byte> buffer(1 << 16);
+	for (auto _ : _benchmark_state)
+	{
+		std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+		auto fill = [](auto& s) { for (uint64_t i = 0; i < 256; i++) s.insert(i * 0x9e3779b97f4a7c15ull); benchmark::DoNotOptimize(s.size()); };
+		if constexpr (ARENA) { wy::pmr::flat_set<uint64_t> s(&arena); fill(s); }
+		else { wy::flat_set<uint64_t> s; fill(s); }
+	}
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * 256);
+}
+BENCHMARK(flat_set_temporary<false>);
+BENCHMARK(flat_set_temporary<true>);
+
+// Lookups of random keys on a table much bigger than the cache: one after another or with wy::batch_find
+template<class KEY> static KEY make_dram_key(uint64_t i)
+{
+	if constexpr (std::is_same_v<KEY, std::string>) return "user/session/" + std::to_string(i * 7919);
+	else return i;
+}
+template<class KEY, bool BATCH> static void flat_map_find_dram(benchmark::State& _benchmark_state)
+{
+	static wy::flat_map<KEY, uint64_t> m = [] {
+		wy::flat_map<KEY, uint64_t> result;
+		for (uint64_t i = 0; i < (1 << 21); i++) result[make_dram_key<KEY>(i)] = i;
+		return result;
+	}();
+	wy::rand r;
+	std::vector<KEY> keys(1 << 12);
+	for (KEY& key : keys) key = make_dram_key<KEY>(r.uniform_dist(1 << 22));// Half found
+	std::vector<typename wy::flat_map<KEY, uint64_t>::iterator> out(keys.size());
+
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		if constexpr (BATCH)
+			no_op += wy::batch_find(m, keys, out);
+		else
+			for (size_t i = 0; i < keys.size(); i++) { out[i] = m.find(keys[i]); no_op += out[i] != m.end(); }
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+BENCHMARK(flat_map_find_dram<uint64_t, false>);
+BENCHMARK(flat_map_find_dram<uint64_t, true>);
+BENCHMARK(flat_map_find_dram<std::string, false>);
+BENCHMARK(flat_map_find_dram<std::string, true>);
+
+// Cost of wy::hash_stats, recording when WY_INSTRUMENT is 1 (0 by default)
+template<class HASHER> static void hash_string_stats(benchmark::State& _benchmark_state)
+{
+	HASHER hasher; // Create a hash generator
+	std::string key = "a key of 28 characters......";
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) { key[0] = static_cast<char>(no_op); no_op += hasher(key); }
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(hash_string_stats<wy::hash<std::string>>);
+BENCHMARK(hash_string_stats<wy::hash_stats<wy::hash<std::string>>>);
+
+// Struct with 13 bytes of padding: its bytes, or its fields with wy::aggregate_hash
+struct padded_key { uint8_t kind; uint64_t id; uint16_t shard; };
+template<class HASHER> static void hash_padded_struct(benchmark::State& _benchmark_state)
+{
+	HASHER hasher; // Create a hash generator
+	padded_key key = { 1, 2, 3 };
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) { key.id = no_op; no_op += hasher(key); }
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(hash_padded_struct<wy::hash<padded_key>>);
+BENCHMARK(hash_padded_struct<wy::aggregate_hash<padded_key>>);
 
 // Hash uint32_t
 static void std_hash_uint32(benchmark::State& _benchmark_state)
@@ -217,13 +529,30 @@ static void std_hash_string(benchmark::State& _benchmark_state)
 	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
 }
 BENCHMARK(std_hash_string)->Range(16, 4096);
+static void wy_hash128_string(benchmark::State& _benchmark_state)
+{
+	wy::hash128 hasher; // Create a hash generator
+	int64_t string_length = _benchmark_state.range(0);
+	std::string s;
+	s.assign(string_length, 'a');
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		wy::digest128 digest = hasher(s);
+		no_op += digest.low ^ digest.high;
+		memcpy(s.data(), &no_op, sizeof(no_op));
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(wy_hash128_string)->Range(16, 4096);
 
 // Hash struct
 template<uint32_t SIZE> static void wy_hash_array(benchmark::State& _benchmark_state)
 {
 	wy::hash<std::array<uint8_t, SIZE>> hasher; // Create a hash generator
-	int64_t string_length = _benchmark_state.range(0);
-	std::array<uint8_t, SIZE> array_to_hash;
+	std::array<uint8_t, SIZE> array_to_hash = {};
 	uint64_t no_op = 0; // variable to restrict compiler optimizations
 	for (auto _ : _benchmark_state)
 	{
@@ -245,3 +574,379 @@ BENCHMARK(wy_hash_array<35>);
 
 BENCHMARK(wy_hash_array<64>);
 BENCHMARK(wy_hash_array<67>);
+
+// Hash many short strings
+static std::vector<std::string> short_keys(size_t count)
+{
+	wy::rand r(7);
+	std::vector<std::string> keys(count);
+	for (auto& key : keys)
+		key.assign(4 + r.uniform_dist(13), 'k');
+	return keys;
+}
+static void wy_hash_string_single(benchmark::State& _benchmark_state)
+{
+	wy::hash<std::string> hasher; // Create a hash generator
+	std::vector<std::string> keys = short_keys(1024);
+	std::vector<uint64_t> out(keys.size());
+	for (auto _ : _benchmark_state)
+	{
+		for (size_t i = 0; i < keys.size(); i++)
+			out[i] = hasher(keys[i]);
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+BENCHMARK(wy_hash_string_single);
+static void wy_hash_string_batch(benchmark::State& _benchmark_state)
+{
+	wy::hash<std::string> hasher; // Create a hash generator
+	std::vector<std::string> keys = short_keys(1024);
+	std::vector<uint64_t> out(keys.size());
+	for (auto _ : _benchmark_state)
+	{
+		hasher.hash_batch(keys.data(), out.data(), keys.size());
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+BENCHMARK(wy_hash_string_batch);
+
+// Hash a big buffer: linear and tree mode
+static void wy_hash_linear_big(benchmark::State& _benchmark_state)
+{
+	wy::internal::hash_imp hasher; // Create a hash generator
+	std::vector<uint8_t> data = wy::rand().generate_stream(64 << 20);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += hasher.wyhash(data.data(), data.size());
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * data.size());
+}
+BENCHMARK(wy_hash_linear_big);
+static void wy_hash_tree_big(benchmark::State& _benchmark_state)
+{
+	std::vector<uint8_t> data = wy::rand().generate_stream(64 << 20);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::hash_tree(data.data(), data.size());
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * data.size());
+}
+BENCHMARK(wy_hash_tree_big);
+
+// Hash tables: insert and find
+#include <unordered_map>
+template<class MAP> static void hash_table_find_string(benchmark::State& _benchmark_state)
+{
+	size_t size = static_cast<size_t>(_benchmark_state.range(0));
+	std::vector<std::string> keys;
+	for (size_t i = 0; i < size; i++)
+		keys.push_back("key " + std::to_string(i * 7919));
+
+	MAP map;
+	for (size_t i = 0; i < size; i++)
+		map[keys[i]] = i;
+
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	size_t i = 0;
+	for (auto _ : _benchmark_state)
+	{
+		no_op += map.find(keys[i])->second;
+		if (++i == size) i = 0;
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(hash_table_find_string<std::unordered_map<std::string, size_t, wy::hash<std::string>>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(hash_table_find_string<wy::flat_map<std::string, size_t>>)->Range(1 << 10, 1 << 20);
+static void hash_table_find_string_perfect(benchmark::State& _benchmark_state)
+{
+	size_t size = static_cast<size_t>(_benchmark_state.range(0));
+	std::vector<std::pair<std::string, size_t>> elems;
+	for (size_t i = 0; i < size; i++)
+		elems.emplace_back("key " + std::to_string(i * 7919), i);
+
+	wy::perfect_hash_map<std::string, size_t> map(elems.begin(), elems.end());
+
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	size_t i = 0;
+	for (auto _ : _benchmark_state)
+	{
+		no_op += map.find(elems[i].first)->second;
+		if (++i == size) i = 0;
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations());
+}
+BENCHMARK(hash_table_find_string_perfect)->Range(1 << 10, 1 << 20);
+template<class MAP> static void hash_table_insert_uint64(benchmark::State& _benchmark_state)
+{
+	size_t size = static_cast<size_t>(_benchmark_state.range(0));
+	for (auto _ : _benchmark_state)
+	{
+		MAP map;
+		for (uint64_t i = 0; i < size; i++)
+			map[i * 0x9e3779b97f4a7c15ull] = i;
+		benchmark::DoNotOptimize(map.size());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * size);
+}
+BENCHMARK(hash_table_insert_uint64<std::unordered_map<uint64_t, uint64_t, wy::hash<uint64_t>>>)->Range(1 << 10, 1 << 20);
+BENCHMARK(hash_table_insert_uint64<wy::flat_map<uint64_t, uint64_t>>)->Range(1 << 10, 1 << 20);
+
+// Filters
+template<bool BATCH> static void bloom_filter_contains(benchmark::State& _benchmark_state)
+{
+	size_t size = static_cast<size_t>(_benchmark_state.range(0));
+	wy::rand r;
+	std::vector<uint64_t> keys(size);
+	r.generate_stream(std::span<uint64_t>(keys));
+
+	wy::bloom_filter<uint64_t> filter(size, 0.01);
+	filter.insert(keys);
+
+	std::unique_ptr<bool[]> results(new bool[size]);
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		if constexpr (BATCH)
+			no_op += filter.contains(keys, std::span<bool>(results.get(), size));
+		else
+			for (uint64_t key : keys)
+				no_op += filter.contains(key);
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * size);
+}
+BENCHMARK(bloom_filter_contains<false>)->Range(1 << 12, 1 << 24);
+BENCHMARK(bloom_filter_contains<true>)->Range(1 << 12, 1 << 24);
+
+// Cardinality estimation
+static void hyperloglog_add(benchmark::State& _benchmark_state)
+{
+	size_t size = static_cast<size_t>(_benchmark_state.range(0));
+	std::vector<uint64_t> keys(size);
+	for (size_t i = 0; i < size; i++)
+		keys[i] = i;
+
+	for (auto _ : _benchmark_state)
+	{
+		wy::hyperloglog<uint64_t> sketch;
+		sketch.add(keys);
+		benchmark::DoNotOptimize(sketch.estimate());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * size);
+}
+BENCHMARK(hyperloglog_add)->Range(1 << 10, 1 << 20);
+
+// Key corpora: deterministic keys with realistic lengths, to measure hashing in 'throughput' mode
+// (independent keys, the multiplications overlap) and 'latency' mode (the next key depends on the last hash)
+enum class corpus { zipf_words, urls, uuids };
+static std::vector<std::string> make_corpus(corpus type, size_t count)
+{
+	wy::rand r(static_cast<uint64_t>(type) + 1);
+	auto word = [&r](size_t len) {
+		std::string result(len, 'a');
+		for (char& c : result) c = static_cast<char>('a' + r.uniform_dist(26));
+		return result;
+	};
+
+	std::vector<std::string> keys;
+	keys.reserve(count);
+	if (type == corpus::zipf_words)
+	{
+		// Zipfian popularity over a vocabulary where the popular words are shorter, like natural language
+		std::vector<std::string> vocabulary;
+		for (size_t i = 0; i < 10'000; i++)
+			vocabulary.push_back(word(2 + static_cast<size_t>(std::log2(i + 1.0))));
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t rank = static_cast<size_t>(std::exp(r.uniform_dist() * std::log(vocabulary.size() + 1.0))) - 1;
+			keys.push_back(vocabulary[rank < vocabulary.size() ? rank : vocabulary.size() - 1]);
+		}
+	}
+	else if (type == corpus::urls)
+	{
+		const char* tlds[] = { ".com", ".org", ".net", ".io", ".de" };
+		for (size_t i = 0; i < count; i++)
+		{
+			std::string url = "https://www." + word(5 + r.uniform_dist(8)) + tlds[r.uniform_dist(5)];
+			for (uint64_t j = 0, segments = 1 + r.uniform_dist(4); j < segments; j++)
+				url += "/" + word(3 + r.uniform_dist(8));
+			if (r() & 1)
+				url += "?id=" + std::to_string(r.uniform_dist(1'000'000));
+			keys.push_back(std::move(url));
+		}
+	}
+	else
+	{
+		const char* hex = "0123456789abcdef";
+		for (size_t i = 0; i < count; i++)
+		{
+			std::string uuid = "xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx";
+			uint64_t bits = r();
+			for (char& c : uuid)
+			{
+				if (c != 'x' && c != 'y') continue;
+				c = hex[c == 'x' ? (bits & 15) : (8 | (bits & 3))];
+				bits >>= 4;
+				if (!bits) bits = r();
+			}
+			keys.push_back(std::move(uuid));
+		}
+	}
+	return keys;
+}
+static const std::vector<std::string>& get_corpus(corpus type)
+{
+	static const std::vector<std::string> corpora[] = { make_corpus(corpus::zipf_words, 1 << 14), make_corpus(corpus::urls, 1 << 14), make_corpus(corpus::uuids, 1 << 14) };
+	return corpora[static_cast<size_t>(type)];
+}
+static size_t corpus_bytes(const std::vector<std::string>& keys)
+{
+	size_t bytes = 0;
+	for (const std::string& key : keys) bytes += key.size();
+	return bytes;
+}
+
+// The reference 'wyhash()' of wyhash.h as a hasher
+struct reference_wyhash
+{
+	uint64_t operator()(const std::string& key) const noexcept { return wyhash(key.data(), key.size(), 0, _wyp); }
+};
+
+template<class HASHER, corpus CORPUS, bool LATENCY> static void hash_corpus(benchmark::State& _benchmark_state)
+{
+	HASHER hasher; // Create a hash generator
+	const std::vector<std::string>& keys = get_corpus(CORPUS);
+	size_t mask = keys.size() - 1;
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		if constexpr (LATENCY)
+		{
+			// Each key is selected by the hash of the previous one: measures the full latency of a hash
+			size_t i = 0;
+			for (size_t n = 0; n < keys.size(); n++)
+			{
+				uint64_t h = hasher(keys[i]);
+				no_op += h;
+				i = (i + 1 + (h & 7)) & mask;
+			}
+		}
+		else
+			for (const std::string& key : keys)
+				no_op += hasher(key);
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+	if constexpr (!LATENCY)
+		_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * corpus_bytes(keys));
+}
+// Throughput
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::zipf_words, false>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::zipf_words, false>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::zipf_words, false>);
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::urls, false>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::urls, false>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::urls, false>);
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::uuids, false>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::uuids, false>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::uuids, false>);
+// Latency
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::zipf_words, true>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::zipf_words, true>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::zipf_words, true>);
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::urls, true>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::urls, true>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::urls, true>);
+BENCHMARK(hash_corpus<wy::hash<std::string>, corpus::uuids, true>);
+BENCHMARK(hash_corpus<reference_wyhash, corpus::uuids, true>);
+BENCHMARK(hash_corpus<std::hash<std::string>, corpus::uuids, true>);
+
+// Hash tables with the key corpora: the maps hold the distinct keys, the lookups follow the corpus distribution
+template<class MAP, corpus CORPUS> static void hash_table_insert_corpus(benchmark::State& _benchmark_state)
+{
+	const std::vector<std::string>& keys = get_corpus(CORPUS);
+	for (auto _ : _benchmark_state)
+	{
+		MAP map;
+		for (size_t i = 0; i < keys.size(); i++)
+			map.emplace(keys[i], i);
+		benchmark::DoNotOptimize(map.size());
+	}
+
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+template<class MAP, corpus CORPUS> static void hash_table_find_corpus(benchmark::State& _benchmark_state)
+{
+	const std::vector<std::string>& keys = get_corpus(CORPUS);
+	MAP map;
+	for (size_t i = 0; i < keys.size(); i++)
+		map.emplace(keys[i], i);
+
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+		for (const std::string& key : keys)
+			no_op += map.find(key)->second;
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::zipf_words>);
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t>, corpus::zipf_words>);
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::urls>);
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t>, corpus::urls>);
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::uuids>);
+BENCHMARK(hash_table_insert_corpus<std::unordered_map<std::string, size_t>, corpus::uuids>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::zipf_words>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t>, corpus::zipf_words>);
+BENCHMARK(hash_table_find_corpus<wy::flat_map<std::string, size_t>, corpus::zipf_words>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::urls>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t>, corpus::urls>);
+BENCHMARK(hash_table_find_corpus<wy::flat_map<std::string, size_t>, corpus::urls>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t, wy::hash<std::string>>, corpus::uuids>);
+BENCHMARK(hash_table_find_corpus<std::unordered_map<std::string, size_t>, corpus::uuids>);
+BENCHMARK(hash_table_find_corpus<wy::flat_map<std::string, size_t>, corpus::uuids>);
+
+// Multi-thread scaling: every thread hashes the shared corpus or generates its own random stream
+static void hash_corpus_threads(benchmark::State& _benchmark_state)
+{
+	wy::hash<std::string> hasher; // Create a hash generator
+	const std::vector<std::string>& keys = get_corpus(corpus::urls);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+		for (const std::string& key : keys)
+			no_op += hasher(key);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetItemsProcessed(_benchmark_state.iterations() * keys.size());
+}
+BENCHMARK(hash_corpus_threads)->ThreadRange(1, 16)->UseRealTime();
+static void wy_rand_stream_threads(benchmark::State& _benchmark_state)
+{
+	wy::rand r = wy::rand(1).substream(static_cast<uint64_t>(_benchmark_state.thread_index())); // Create a pseudo-random generator
+	std::vector<uint8_t> vec(1 << 16);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		r.generate_stream(std::span<uint8_t>(vec));
+		no_op += vec[0];
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	_benchmark_state.SetBytesProcessed(_benchmark_state.iterations() * vec.size());
+}
+BENCHMARK(wy_rand_stream_threads)->ThreadRange(1, 16)->UseRealTime();
+
+// Recorded on the JSON output ('--benchmark_out_format=json'), to compare runs over time
+static const bool wy_benchmark_context = (benchmark::AddCustomContext("wy_cpu_path", wy::cpu_path_name(wy::active_cpu_path())), true);
@@ -0,0 +1,356 @@
+/////////////////////////////////////////////////////////////////////////////////
+// This file is a C++ wrapper around wyhash:
+// https://github.com/wangyi-fudan/wyhash
+//
+// Copyright (c) 2022-2024 by Alain Espinosa.
+/////////////////////////////////////////////////////////////////////////////////
+
+// Thread scaling of random generation, hashing and containers: each benchmark runs on 1..N threads pinned to one
+// CPU each (in the order of the process affinity, so a multi-socket machine fills the first socket first).
+// 'per_core' counters give the rate of one thread: flat when a workload scales, falling when the memory bandwidth,
+// a shared cache line or the NUMA interconnect dominates.
+
+// include the required header
+#define WY_THREADS 1 // The parallel modes on threads
+#include <wy.hpp>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <filesystem>
+#ifdef __linux__
+	#include <pthread.h>
+	#include <sched.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////
+// Thread placement
+/////////////////////////////////////////////////////////////////////////////////
+// The CPUs the process can run on
+static const std::vector<unsigned>& allowed_cpus()
+{
+	static const std::vector<unsigned> cpus = [] {
+		std::vector<unsigned> result;
+#if defined(__linux__)
+		cpu_set_t set;
+		if (sched_getaffinity(0, sizeof(set), &set) == 0)
+			for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++)
+				if (CPU_ISSET(cpu, &set)) result.push_back(cpu);
+#elif defined(_WIN32)
+		DWORD_PTR process_mask, system_mask;
+		if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+			for (unsigned cpu = 0; cpu < sizeof(DWORD_PTR) * 8; cpu++)
+				if ((process_mask >> cpu) & 1) result.push_back(cpu);
+#endif
+		if (result.empty())
+			for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++) result.push_back(cpu);
+		return result;
+	}();
+	return cpus;
+}
+
+// Pin the calling benchmark thread to one CPU, restoring the previous affinity on destruction: the main thread also runs
+// benchmarks, and threads created later inherit its affinity
+class pin_thread
+{
+public:
+	explicit pin_thread(const benchmark::State& state)
+	{
+		unsigned cpu = allowed_cpus()[static_cast<size_t>(state.thread_index()) % allowed_cpus().size()];
+#if defined(__linux__)
+		pinned = pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) == 0;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pinned = pinned && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+		previous = SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu);
+		pinned = previous != 0;
+#else
+		(void)cpu;
+#endif
+	}
+	~pin_thread()
+	{
+#if defined(__linux__)
+		if (pinned) pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+#elif defined(_WIN32)
+		if (pinned) SetThreadAffinityMask(GetCurrentThread(), previous);
+#endif
+	}
+	pin_thread(const pin_thread&) = delete;
+	pin_thread& operator=(const pin_thread&) = delete;
+
+private:
+	bool pinned = false;
+#if defined(__linux__)
+	cpu_set_t previous;
+#elif defined(_WIN32)
+	DWORD_PTR previous = 0;
+#endif
+};
+
+// Threads 1, 2, 4 ... and the number of CPUs
+static void thread_counts(benchmark::internal::Benchmark* b)
+{
+	unsigned num_cpus = static_cast<unsigned>(allowed_cpus().size());
+	for (unsigned threads = 1; threads < num_cpus; threads *= 2)
+		b->Threads(static_cast<int>(threads));
+	b->Threads(static_cast<int>(num_cpus));
+	b->UseRealTime();
+}
+// Same values for the threads that a parallel mode creates itself
+static void parallel_mode_threads(benchmark::internal::Benchmark* b)
+{
+	unsigned num_cpus = static_cast<unsigned>(allowed_cpus().size());
+	for (unsigned threads = 1; threads < num_cpus; threads *= 2)
+		b->Arg(threads);
+	b->Arg(num_cpus);
+	b->UseRealTime();
+}
+
+// The rates of one thread, next to the totals
+static void set_rates(benchmark::State& state, double bytes, double ops)
+{
+	if (bytes > 0) state.SetBytesProcessed(static_cast<int64_t>(bytes));
+	if (ops > 0) state.SetItemsProcessed(static_cast<int64_t>(ops));
+	if (bytes > 0) state.counters["bytes_per_core"] = benchmark::Counter(bytes, benchmark::Counter::kIsRate | benchmark::Counter::kAvgThreads);
+	if (ops > 0) state.counters["ops_per_core"] = benchmark::Counter(ops, benchmark::Counter::kIsRate | benchmark::Counter::kAvgThreads);
+}
+static void set_parallel_mode_rates(benchmark::State& state, double bytes, double ops)
+{
+	double num_threads = static_cast<double>(state.range(0));
+	if (bytes > 0) state.SetBytesProcessed(static_cast<int64_t>(bytes));
+	if (ops > 0) state.SetItemsProcessed(static_cast<int64_t>(ops));
+	if (bytes > 0) state.counters["bytes_per_core"] = benchmark::Counter(bytes / num_threads, benchmark::Counter::kIsRate);
+	if (ops > 0) state.counters["ops_per_core"] = benchmark::Counter(ops / num_threads, benchmark::Counter::kIsRate);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// Random generation: one generator by thread
+/////////////////////////////////////////////////////////////////////////////////
+// Buffer on the cache (compute bound) or much bigger (memory bandwidth bound). Allocated by each thread, so its pages
+// are on the NUMA node of the thread
+static void scaling_generate_stream(benchmark::State& _benchmark_state)
+{
+	pin_thread pin(_benchmark_state);
+	wy::rand r = wy::rand(1).substream(static_cast<uint64_t>(_benchmark_state.thread_index())); // Create a pseudo-random generator
+	std::vector<uint8_t> vec(static_cast<size_t>(_benchmark_state.range(0)));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		r.generate_stream(std::span<uint8_t>(vec));
+		no_op += vec[0];
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(vec.size()), 0);
+}
+BENCHMARK(scaling_generate_stream)->Arg(1 << 15)->Arg(1 << 26)->Apply(thread_counts);
+
+// Generators next to each other on memory: every call writes a cache line shared with other threads. Padded to
+// a cache line each, as 'thread_rand()' does with thread_local storage
+template<bool PADDED> static void scaling_rand_state_layout(benchmark::State& _benchmark_state)
+{
+	struct alignas(PADDED ? 64 : alignof(wy::rand)) slot { wy::rand r; };
+	static std::vector<slot> slots(256);
+	pin_thread pin(_benchmark_state);
+	wy::rand& r = slots[static_cast<size_t>(_benchmark_state.thread_index()) % slots.size()].r;
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		no_op += r();
+		benchmark::ClobberMemory();// Store the state on each call, as a generator shared by reference would
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()));
+}
+BENCHMARK(scaling_rand_state_layout<false>)->Apply(thread_counts);
+BENCHMARK(scaling_rand_state_layout<true>)->Apply(thread_counts);
+
+// One generator shared by all the threads
+static void scaling_atomic_rand(benchmark::State& _benchmark_state)
+{
+	static wy::atomic_rand shared(1);
+	pin_thread pin(_benchmark_state);
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += shared();
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()));
+}
+BENCHMARK(scaling_atomic_rand)->Apply(thread_counts);
+
+/////////////////////////////////////////////////////////////////////////////////
+// Hashing
+/////////////////////////////////////////////////////////////////////////////////
+// 'hash_imp::wyhash' over a buffer by thread: on the cache or from memory
+static void scaling_wyhash(benchmark::State& _benchmark_state)
+{
+	pin_thread pin(_benchmark_state);
+	wy::internal::hash_imp hasher; // Create a hash generator
+	std::vector<uint8_t> data = wy::rand(static_cast<uint64_t>(_benchmark_state.thread_index())).generate_stream(static_cast<size_t>(_benchmark_state.range(0)));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += hasher.wyhash(data.data(), data.size());
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(data.size()), static_cast<double>(_benchmark_state.iterations()));
+}
+BENCHMARK(scaling_wyhash)->Arg(1 << 15)->Arg(1 << 26)->Apply(thread_counts);
+
+// Short keys: compute bound on all the threads
+static void scaling_hash_short_keys(benchmark::State& _benchmark_state)
+{
+	pin_thread pin(_benchmark_state);
+	wy::hash<std::string> hasher; // Create a hash generator
+	std::vector<std::string> keys;
+	for (size_t i = 0; i < 4096; i++) keys.push_back("user/" + std::to_string(i * 7919));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+		for (const std::string& key : keys)
+			no_op += hasher(key);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(keys.size()));
+}
+BENCHMARK(scaling_hash_short_keys)->Apply(thread_counts);
+
+/////////////////////////////////////////////////////////////////////////////////
+// Containers: one table by thread
+/////////////////////////////////////////////////////////////////////////////////
+static void scaling_flat_map_insert(benchmark::State& _benchmark_state)
+{
+	pin_thread pin(_benchmark_state);
+	std::vector<uint64_t> keys = wy::rand(static_cast<uint64_t>(_benchmark_state.thread_index())).generate_stream<uint64_t>(static_cast<size_t>(_benchmark_state.range(0)));
+	for (auto _ : _benchmark_state)
+	{
+		wy::flat_map<uint64_t, uint64_t> m;
+		for (uint64_t key : keys) m[key] = key;
+		benchmark::DoNotOptimize(m.size());
+	}
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(keys.size()));
+}
+BENCHMARK(scaling_flat_map_insert)->Arg(1 << 12)->Arg(1 << 20)->Apply(thread_counts);
+
+static void scaling_flat_map_find(benchmark::State& _benchmark_state)
+{
+	pin_thread pin(_benchmark_state);
+	wy::rand r(static_cast<uint64_t>(_benchmark_state.thread_index()));
+	std::vector<uint64_t> keys = r.generate_stream<uint64_t>(static_cast<size_t>(_benchmark_state.range(0)));
+	wy::flat_map<uint64_t, uint64_t> m;
+	for (uint64_t key : keys) m[key] = key;
+	wy::shuffle(std::span<uint64_t>(keys), r);
+	std::vector<wy::flat_map<uint64_t, uint64_t>::iterator> out(keys.size());
+	size_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::batch_find(m, keys, out);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(keys.size()));
+}
+BENCHMARK(scaling_flat_map_find)->Arg(1 << 12)->Arg(1 << 20)->Apply(thread_counts);
+
+/////////////////////////////////////////////////////////////////////////////////
+// Containers: one table shared by all the threads
+/////////////////////////////////////////////////////////////////////////////////
+// A cache: 1 write every 'range(0)' operations on 1 << 16 keys. 'wy::concurrent_map' against the common
+// std::unordered_map behind one std::shared_mutex, where every reader writes the cache line of the lock
+template<class MAP> static void shared_map_mixed(benchmark::State& _benchmark_state, MAP& m, std::shared_mutex* lock)
+{
+	pin_thread pin(_benchmark_state);
+	wy::rand r(static_cast<uint64_t>(_benchmark_state.thread_index()));
+	uint64_t write_every = static_cast<uint64_t>(_benchmark_state.range(0));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state)
+	{
+		uint64_t key = r.uniform_dist(1 << 16);
+		if constexpr (std::is_same_v<MAP, std::unordered_map<uint64_t, uint64_t, wy::hash<uint64_t>>>)
+		{
+			if (r.uniform_dist(write_every) == 0) { std::unique_lock write(*lock); m[key] = key; }
+			else { std::shared_lock read(*lock); auto it = m.find(key); no_op += it != m.end() ? it->second : 0; }
+		}
+		else
+		{
+			if (r.uniform_dist(write_every) == 0) m.insert_or_assign(key, key);
+			else no_op += m.find(key).value_or(0);
+		}
+	}
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()));
+}
+static void scaling_concurrent_map(benchmark::State& _benchmark_state)
+{
+	static wy::concurrent_map<uint64_t, uint64_t> m;
+	shared_map_mixed(_benchmark_state, m, nullptr);
+}
+BENCHMARK(scaling_concurrent_map)->Arg(10)->Arg(1000)->Apply(thread_counts);
+static void scaling_locked_unordered_map(benchmark::State& _benchmark_state)
+{
+	static std::unordered_map<uint64_t, uint64_t, wy::hash<uint64_t>> m;
+	static std::shared_mutex lock;
+	shared_map_mixed(_benchmark_state, m, &lock);
+}
+BENCHMARK(scaling_locked_unordered_map)->Arg(10)->Arg(1000)->Apply(thread_counts);
+
+/////////////////////////////////////////////////////////////////////////////////
+// Parallel modes: one call creates the threads, 'num_threads' as argument
+/////////////////////////////////////////////////////////////////////////////////
+static void scaling_hash_tree(benchmark::State& _benchmark_state)
+{
+	static const std::vector<uint8_t> data = wy::rand(1).generate_stream(1 << 28);
+	unsigned num_threads = static_cast<unsigned>(_benchmark_state.range(0));
+	uint64_t no_op = 0; // variable to restrict compiler optimizations
+	for (auto _ : _benchmark_state) no_op += wy::hash_tree(data.data(), data.size(), 1 << 22, num_threads);
+
+	benchmark::DoNotOptimize(no_op); // Restrict compiler optimizations
+	set_parallel_mode_rates(_benchmark_state, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(data.size()), 0);
+}
+BENCHMARK(scaling_hash_tree)->Apply(parallel_mode_threads);
+
+static void scaling_shuffle(benchmark::State& _benchmark_state)
+{
+	static std::vector<uint32_t> values(1 << 24);
+	unsigned num_threads = static_cast<unsigned>(_benchmark_state.range(0));
+	wy::rand r(1);
+	for (auto _ : _benchmark_state)
+	{
+		wy::shuffle(std::span<uint32_t>(values), r, num_threads);
+		benchmark::ClobberMemory();
+	}
+	set_parallel_mode_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(values.size()));
+}
+BENCHMARK(scaling_shuffle)->Apply(parallel_mode_threads);
+
+static void scaling_alias_table_fill(benchmark::State& _benchmark_state)
+{
+	static const wy::alias_table table(std::vector<double>(1024, 1.0));
+	static std::vector<uint32_t> indexes(1 << 24);
+	unsigned num_threads = static_cast<unsigned>(_benchmark_state.range(0));
+	wy::rand r(1);
+	for (auto _ : _benchmark_state)
+	{
+		table.fill(std::span<uint32_t>(indexes), r, num_threads);
+		benchmark::ClobberMemory();
+	}
+	set_parallel_mode_rates(_benchmark_state, 0, static_cast<double>(_benchmark_state.iterations()) * static_cast<double>(indexes.size()));
+}
+BENCHMARK(scaling_alias_table_fill)->Apply(parallel_mode_threads);
+
+// Recorded on the JSON output ('--benchmark_out_format=json'): the machine topology of the run
+static unsigned count_numa_nodes()
+{
+	unsigned nodes = 0;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+		if (entry.path().filename().string().rfind("node", 0) == 0) nodes++;
+	return nodes ? nodes : 1;
+}
+static const bool wy_scaling_context = (
+	benchmark::AddCustomContext("wy_cpu_path", wy::cpu_path_name(wy::active_cpu_path())),
+	benchmark::AddCustomContext("wy_pinned_cpus", std::to_string(allowed_cpus().size())),
+	benchmark::AddCustomContext("wy_numa_nodes", std::to_string(count_numa_nodes())), true);
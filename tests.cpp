@@ -6,10 +6,20 @@
 /////////////////////////////////////////////////////////////////////////////////
 
 // include the required header
+// The optional parts: file hashing and the threads of the parallel modes
+#define WY_FILE_HASHING 1
+#define WY_THREADS 1
 #include <wy.hpp>
 #include <gtest/gtest.h>
 #include "wyhash.h"
 #include <memory_resource>
+#include <fstream>
+#include <list>
+#include <deque>
+#include <map>
+#include <bit>
+#include <algorithm>
+#include <numeric>
 
 /////////////////////////////////////////////////////////////////////////////////
 /// General
@@ -83,6 +93,109 @@ TEST(wyrand, Operator)
 	}
 }
 
+TEST(wyrand, Discard)
+{
+	for (uint64_t seed = 0; seed < 1'000; seed++)
+	{
+		wy::rand r(seed);
+		wy::rand r0(seed);
+
+		r.discard(seed);
+		for (uint64_t i = 0; i < seed; i++)
+			r0();
+		ASSERT_EQ(r.state, r0.state);
+		ASSERT_EQ(r(), r0());
+	}
+}
+
+TEST(wyrand, Substreams)
+{
+	wy::rand r(0x5b5);
+	std::vector<wy::rand> workers = r.split(8);
+	ASSERT_EQ(workers.size(), 8);
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		// Don't depend on the number of workers
+		ASSERT_EQ(workers[i].state, r.substream(i).state);
+		ASSERT_EQ(workers[i].state, r.split(i + 1)[i].state);
+
+		wy::rand r0(r.state);
+		r0.discard(i * wy::rand::substream_length);
+		ASSERT_EQ(workers[i](), r0());
+	}
+	// Last substream ends where the first one starts
+	wy::rand last = r.substream(wy::rand::max_substreams - 1);
+	last.discard(wy::rand::substream_length);
+	ASSERT_EQ(last.state, r.state);
+}
+
+TEST(wyrand, ThreadRand)
+{
+	wy::rand& r = wy::thread_rand();
+	ASSERT_EQ(&r, &wy::thread_rand());// One generator by thread
+	uint64_t value = r();
+
+	// Other threads use other substreams of the same seed
+	std::vector<uint64_t> states(4);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < states.size(); i++)
+		threads.emplace_back([&states, i]() { states[i] = wy::thread_rand().state; });
+	for (std::thread& t : threads)
+		t.join();
+	for (size_t i = 0; i < states.size(); i++)
+	{
+		ASSERT_NE(states[i], r.state);
+		bool is_substream = false;
+		for (uint64_t k = 0; k < wy::internal::thread_rand_count; k++)
+			is_substream |= wy::rand(wy::internal::thread_rand_seed()).substream(k).state == states[i];
+		ASSERT_TRUE(is_substream);
+		for (size_t j = 0; j < i; j++)
+			ASSERT_NE(states[i], states[j]);
+	}
+	ASSERT_NE(wy::thread_rand()(), value);
+}
+
+TEST(wyrand, AtomicRand)
+{
+	const size_t num_threads = 4, per_thread = 10'000;
+	wy::atomic_rand shared(0x7a3);
+
+	std::vector<std::vector<uint64_t>> values(num_threads);
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < num_threads; i++)
+		threads.emplace_back([&shared, &values, i]() {
+			for (size_t j = 0; j < per_thread; j++)
+				values[i].push_back(shared());
+		});
+	for (std::thread& t : threads)
+		t.join();
+
+	// The threads shared the serial sequence, each value once
+	std::vector<uint64_t> all, expected;
+	for (const auto& v : values)
+		all.insert(all.end(), v.begin(), v.end());
+	wy::rand serial(0x7a3);
+	for (size_t i = 0; i < all.size(); i++)
+		expected.push_back(serial());
+	std::sort(all.begin(), all.end());
+	std::sort(expected.begin(), expected.end());
+	ASSERT_EQ(all, expected);
+
+	// Reserved blocks and discard
+	wy::rand block = shared.reserve(100);
+	ASSERT_EQ(block.state, serial.state);
+	for (size_t i = 0; i < 100; i++)
+		ASSERT_EQ(block(), serial());
+	shared.discard(5);
+	serial.discard(5);
+	ASSERT_EQ(shared(), serial());
+
+	std::uniform_int_distribution<int> dist(1, 6);
+	int dice = dist(shared);
+	ASSERT_TRUE(dice >= 1 && dice <= 6);
+}
+
 TEST(wyrand, Uniform)
 {
 	for (uint64_t seed = 0; seed < 1'000'000; seed++)
@@ -124,6 +237,224 @@ TEST(wyrand, Gaussian)
 	}
 }
 
+TEST(wyrand, UniformUnbiased)
+{
+	wy::rand r(0x13);
+	size_t counts[3] = {};
+	for (size_t i = 0; i < 300'000; i++)
+		counts[r.uniform_dist_unbiased(3)]++;
+	for (size_t count : counts)
+		ASSERT_NEAR(count, 100'000.0, 1'000.0);
+
+	// Half of the values are rejected
+	uint64_t max_value = (1ull << 63) + 1;
+	size_t low_half = 0;
+	for (size_t i = 0; i < 100'000; i++)
+	{
+		uint64_t val = r.uniform_dist_unbiased(max_value);
+		ASSERT_LT(val, max_value);
+		low_half += val < (1ull << 62);
+	}
+	ASSERT_NEAR(low_half, 50'000.0, 1'000.0);
+	ASSERT_EQ(r.uniform_dist_unbiased(1), 0);
+}
+
+// Mean and variance of many samples
+template<class SAMPLE> static std::pair<double, double> sample_moments(size_t count, SAMPLE sample)
+{
+	double sum = 0, sum2 = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double val = static_cast<double>(sample());
+		sum += val;
+		sum2 += val * val;
+	}
+	double mean = sum / count;
+	return { mean, sum2 / count - mean * mean };
+}
+
+TEST(wyrand, Normal)
+{
+	wy::rand r(0x21);
+	auto [mean, variance] = sample_moments(1'000'000, [&r]() { return r.normal_dist(); });
+	ASSERT_NEAR(mean, 0, 0.005);
+	ASSERT_NEAR(variance, 1, 0.01);
+
+	size_t below_1 = 0, beyond_3 = 0, beyond_4 = 0;
+	for (size_t i = 0; i < 1'000'000; i++)
+	{
+		double val = r.normal_dist();
+		below_1 += val < 1;
+		beyond_3 += std::fabs(val) > 3;
+		beyond_4 += std::fabs(val) > 4;
+	}
+	ASSERT_NEAR(below_1 / 1e6, 0.841345, 0.002);
+	ASSERT_NEAR(beyond_3 / 1e6, 0.0026998, 0.0003);// Not clipped like 'gaussian_dist()'
+	ASSERT_GT(beyond_4, 30);// 63 expected
+
+	auto [mean_p, variance_p] = sample_moments(100'000, [&r]() { return r.normal_dist(1.1, 2.3); });
+	ASSERT_NEAR(mean_p, 1.1, 0.03);
+	ASSERT_NEAR(variance_p, 2.3 * 2.3, 0.1);
+}
+
+TEST(wyrand, Exponential)
+{
+	wy::rand r(0x22);
+	auto [mean, variance] = sample_moments(1'000'000, [&r]() { return r.exponential_dist(); });
+	ASSERT_NEAR(mean, 1, 0.005);
+	ASSERT_NEAR(variance, 1, 0.02);
+
+	size_t beyond_5 = 0, beyond_8 = 0;
+	for (size_t i = 0; i < 1'000'000; i++)
+	{
+		double val = r.exponential_dist();
+		ASSERT_GE(val, 0);
+		beyond_5 += val > 5;
+		beyond_8 += val > 8;// On the tail, after R = 7.697
+	}
+	ASSERT_NEAR(beyond_5 / 1e6, 0.0067379, 0.0005);
+	ASSERT_NEAR(beyond_8 / 1e6, 0.00033546, 0.0001);
+
+	auto [mean_rate, variance_rate] = sample_moments(100'000, [&r]() { return r.exponential_dist(4); });
+	ASSERT_NEAR(mean_rate, 0.25, 0.005);
+}
+
+TEST(wyrand, Poisson)
+{
+	wy::rand r(0x23);
+	for (double lambda : { 0.5, 3.0, 9.5, 10.0, 50.0, 1e4 })
+	{
+		auto [mean, variance] = sample_moments(200'000, [&r, lambda]() { return r.poisson_dist(lambda); });
+		ASSERT_NEAR(mean / lambda, 1, 0.01) << lambda;
+		ASSERT_NEAR(variance / lambda, 1, 0.03) << lambda;
+	}
+	size_t zeros = 0;
+	for (size_t i = 0; i < 200'000; i++)
+		zeros += r.poisson_dist(3) == 0;
+	ASSERT_NEAR(zeros / 2e5, 0.049787, 0.002);
+	ASSERT_EQ(r.poisson_dist(0), 0);
+}
+
+TEST(sampling, Shuffle)
+{
+	// All the permutations of 4 elements are equally likely
+	wy::rand r(0x31);
+	std::map<std::array<int, 4>, size_t> counts;
+	for (size_t i = 0; i < 240'000; i++)
+	{
+		std::array<int, 4> values = { 0, 1, 2, 3 };
+		wy::shuffle(std::span<int>(values), r);
+		counts[values]++;
+	}
+	ASSERT_EQ(counts.size(), 24);
+	for (const auto& [permutation, count] : counts)
+		ASSERT_NEAR(count, 10'000.0, 500.0);
+
+	// Parallel: a permutation that mixes the tiles, deterministic for the same seed and threads
+	std::vector<uint32_t> values(1 << 17), copy;
+	for (uint32_t i = 0; i < values.size(); i++)
+		values[i] = i;
+	wy::rand r1(0x32), r2(0x32);
+	wy::shuffle(std::span<uint32_t>(values), r1, 4);
+	copy = values;
+	std::sort(copy.begin(), copy.end());
+	for (uint32_t i = 0; i < copy.size(); i++)
+		ASSERT_EQ(copy[i], i);
+	size_t same_quarter = 0;
+	for (size_t i = 0; i < values.size(); i++)
+		same_quarter += (values[i] >> 15) == (i >> 15);
+	ASSERT_NEAR(same_quarter / static_cast<double>(values.size()), 0.25, 0.01);
+
+	copy.resize(values.size());
+	for (uint32_t i = 0; i < copy.size(); i++)
+		copy[i] = i;
+	wy::shuffle(std::span<uint32_t>(copy), r2, 4);
+	ASSERT_EQ(copy, values);
+	ASSERT_EQ(r1.state, r2.state);
+}
+
+TEST(sampling, Sample)
+{
+	// Every element is selected with probability k / size
+	wy::rand r(0x33);
+	std::vector<int> values(100);
+	for (int i = 0; i < 100; i++)
+		values[i] = i;
+	std::vector<size_t> counts(values.size());
+	for (size_t run = 0; run < 20'000; run++)
+	{
+		std::vector<int> selected = wy::sample(values, 10, r);
+		ASSERT_EQ(selected.size(), 10);
+		std::sort(selected.begin(), selected.end());
+		ASSERT_EQ(std::adjacent_find(selected.begin(), selected.end()), selected.end());// Without replacement
+		for (int val : selected)
+			counts[val]++;
+	}
+	for (size_t count : counts)
+		ASSERT_NEAR(count, 2'000.0, 200.0);
+
+	// Parallel
+	std::fill(counts.begin(), counts.end(), 0);
+	for (size_t run = 0; run < 2'000; run++)
+	{
+		std::vector<int> selected = wy::sample(std::span<const int>(values), 50, r, 4);
+		ASSERT_EQ(selected.size(), 50);
+		std::sort(selected.begin(), selected.end());
+		ASSERT_EQ(std::adjacent_find(selected.begin(), selected.end()), selected.end());
+		for (int val : selected)
+			counts[val]++;
+	}
+	for (size_t count : counts)
+		ASSERT_NEAR(count, 1'000.0, 100.0);
+
+	// Not random access but big: skips in bulk
+	std::list<int> list(values.begin(), values.end());
+	std::vector<int> from_list = wy::sample(list, 5, r);
+	ASSERT_EQ(from_list.size(), 5);
+	ASSERT_EQ(wy::sample(list, 200, r).size(), 100);// Less elements than requested
+	ASSERT_TRUE(wy::sample(list, 0, r).empty());
+}
+
+TEST(sampling, AliasTable)
+{
+	std::vector<double> weights = { 1, 2, 0, 3, 4 };
+	wy::alias_table table(weights);
+	ASSERT_EQ(table.size(), weights.size());
+
+	wy::rand r(0x34);
+	std::vector<size_t> counts(weights.size());
+	for (size_t i = 0; i < 1'000'000; i++)
+		counts[table(r)]++;
+	for (size_t i = 0; i < weights.size(); i++)
+		ASSERT_NEAR(counts[i] / 1e6, weights[i] / 10, 0.002);
+	ASSERT_EQ(counts[2], 0);
+
+	// By blocks, also with many threads
+	for (unsigned num_threads : { 1, 4 })
+	{
+		std::vector<uint32_t> indexes(1'000'000);
+		if (num_threads == 1)
+			table.fill(std::span<uint32_t>(indexes), r);
+		else
+			table.fill(std::span<uint32_t>(indexes), r, num_threads);
+		std::fill(counts.begin(), counts.end(), 0);
+		for (uint32_t index : indexes)
+			counts[index]++;
+		for (size_t i = 0; i < weights.size(); i++)
+			ASSERT_NEAR(counts[i] / 1e6, weights[i] / 10, 0.002);
+	}
+	// Same values as one by one
+	wy::rand r1(7), r2(7);
+	std::vector<size_t> block(1000);
+	table.fill(std::span<size_t>(block), r1);
+	for (size_t index : block)
+		ASSERT_EQ(index, table(r2));
+
+	ASSERT_THROW(wy::alias_table(std::vector<double>{}), std::invalid_argument);
+	ASSERT_THROW(wy::alias_table(std::vector<double>{ 1, -1 }), std::invalid_argument);
+	ASSERT_THROW(wy::alias_table(std::vector<double>{ 0, 0 }), std::invalid_argument);
+}
+
 struct StuctTest {
 	char buffer[3];
 };
@@ -202,12 +533,60 @@ TEST(wyhash, BaseImplementation)
 	}
 }
 
+TEST(wyhash, Secret)
+{
+	for (uint64_t seed = 0; seed < 10'000; seed++)
+	{
+		uint64_t expected[4];
+		make_secret(seed, expected);
+		wy::secret s = wy::secret::from_seed(seed);
+		ASSERT_EQ(memcmp(s.words, expected, sizeof(expected)), 0);
+		ASSERT_TRUE(s.is_valid());
+		ASSERT_EQ(wy::secret::from_seed(seed), s);// Cached
+
+		// Serialization round trip
+		std::array<uint8_t, wy::secret::serialized_size> bytes = s.serialize();
+		ASSERT_EQ(bytes[0], static_cast<uint8_t>(expected[0]));
+		ASSERT_EQ(bytes[31], static_cast<uint8_t>(expected[3] >> 56));
+		std::optional<wy::secret> loaded = wy::secret::deserialize(bytes.data(), bytes.size());
+		ASSERT_TRUE(loaded.has_value());
+		ASSERT_EQ(*loaded, s);
+
+		// Hashers from the secret are the seeded hashers
+		wy::hash<std::string> h1(s), h2(seed);
+		ASSERT_EQ(h1("secret"), h2("secret"));
+		ASSERT_EQ(wy::hash<uint64_t>(s)(seed), wy::hash<uint64_t>(seed)(seed));
+	}
+
+	// The default secret of the hashers round trips, and builds the default hashers
+	wy::secret default_secret = wy::secret::default_secret();
+	ASSERT_EQ(memcmp(default_secret.words, wy::internal::default_secret, sizeof(default_secret.words)), 0);
+	ASSERT_TRUE(default_secret.is_valid());
+	std::array<uint8_t, wy::secret::serialized_size> default_bytes = default_secret.serialize();
+	std::optional<wy::secret> default_loaded = wy::secret::deserialize(default_bytes.data(), default_bytes.size());
+	ASSERT_TRUE(default_loaded.has_value());
+	ASSERT_EQ(*default_loaded, default_secret);
+	ASSERT_EQ(wy::hash<std::string>(*default_loaded)("secret"), wy::hash<std::string>()("secret"));
+
+	// Invalid secrets
+	wy::secret s = wy::secret::from_seed(42);
+	std::array<uint8_t, wy::secret::serialized_size> bytes = s.serialize();
+	ASSERT_FALSE(wy::secret::deserialize(bytes.data(), bytes.size() - 1).has_value());
+	bytes[0] ^= 1;// Even
+	ASSERT_FALSE(wy::secret::deserialize(bytes.data(), bytes.size()).has_value());
+	bytes[0] ^= 1;
+	bytes[9] ^= 0x81;// Same parity, 4 bits set broken
+	ASSERT_FALSE(wy::secret::deserialize(bytes.data(), bytes.size()).has_value());
+	wy::secret same = { { s.words[0], s.words[0], s.words[2], s.words[3] } };
+	ASSERT_FALSE(same.is_valid());
+}
+
 TEST(wyhash, TemplateSpecializations)
 {
 	wy::internal::hash_imp h;
 
 	// Normal class
-	StuctTest t;
+	StuctTest t{};
 	wy::hash<StuctTest> h0;
 	ASSERT_EQ(h0(t), h.wyhash((uint8_t*)(&t), sizeof(t)));
 
@@ -244,4 +623,1204 @@ TEST(wyhash, TemplateSpecializations)
 	std::u8string t7 = u8"an example to hash std::u8string";
 	wy::hash<std::u8string> h7;
 	ASSERT_EQ(h7(t7), h.wyhash((uint8_t*)t7.data(), t7.size()));
-}
\ No newline at end of file
+}
+template<size_t N> static void test_fixed_size(const uint8_t* data)
+{
+	wy::internal::hash_imp h;
+	wy::internal::hash_imp h_seed(55);
+	ASSERT_EQ(h.wyhash_fixed<N>(data), h.wyhash(data, N));
+	ASSERT_EQ(h_seed.wyhash_fixed<N>(data + 3), h_seed.wyhash(data + 3, N));
+}
+template<size_t... N> static void test_fixed_sizes(std::index_sequence<N...>)
+{
+	uint8_t data[256];
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = static_cast<uint8_t>(i * 131 + 7);
+
+	(test_fixed_size<N>(data), ...);
+}
+TEST(wyhash, FixedSize)
+{
+	// All the size classes: 0, 1-3, 4-16, 17-48, >48 with all the remainders
+	test_fixed_sizes(std::make_index_sequence<200>());
+
+	// Fixed size types
+	std::array<uint8_t, 35> array;
+	for (size_t i = 0; i < array.size(); i++)
+		array[i] = static_cast<uint8_t>(i);
+	wy::internal::hash_imp h;
+	wy::hash<std::array<uint8_t, 35>> h_array;
+	wy::hash<std::array<uint8_t, 35>*> h_pointer;
+	ASSERT_EQ(h_array(array), h.wyhash(array.data(), array.size()));
+	ASSERT_EQ(h_pointer(&array), h.wyhash(array.data(), array.size()));
+}
+
+TEST(wyhash, Batch)
+{
+	wy::rand r(0x5eed);
+	std::vector<std::vector<uint8_t>> keys;
+	for (size_t len = 0; len < 200; len++)
+		keys.push_back(r.generate_stream(len));
+
+	std::vector<const uint8_t*> ptrs;
+	std::vector<size_t> lens;
+	for (const auto& key : keys)
+	{
+		ptrs.push_back(key.data());
+		lens.push_back(key.size());
+	}
+
+	for (uint64_t seed = 0; seed < 100; seed++)
+	{
+		wy::internal::hash_imp h(seed);
+		std::vector<uint64_t> out(keys.size());
+		// Different number of keys
+		for (size_t n = 0; n <= keys.size(); n += 13)
+		{
+			h.wyhash_batch(ptrs.data(), lens.data(), out.data(), n);
+			for (size_t i = 0; i < n; i++)
+				ASSERT_EQ(out[i], h.wyhash(ptrs[i], lens[i]));
+		}
+	}
+
+	// String specialization
+	std::vector<std::string> strings;
+	for (size_t i = 0; i < 37; i++)
+		strings.push_back(std::string(i, 'a') + std::to_string(i));
+	wy::hash<std::string> hs;
+	std::vector<uint64_t> out(strings.size());
+	hs.hash_batch(strings.data(), out.data(), strings.size());
+	for (size_t i = 0; i < strings.size(); i++)
+		ASSERT_EQ(out[i], hs(strings[i]));
+}
+
+TEST(wyhash, Stream)
+{
+	wy::rand r(0x57ea);
+	std::vector<uint8_t> data = r.generate_stream(1000);
+
+	for (uint64_t seed = 0; seed < 10; seed++)
+	{
+		wy::internal::hash_imp h(seed);
+		for (size_t len = 0; len <= data.size(); len += (len < 200 ? 1 : 37))
+		{
+			uint64_t expected = h.wyhash(data.data(), len);
+
+			// Random chunk sizes
+			wy::hash_stream s(seed);
+			for (size_t pos = 0; pos < len;)
+			{
+				size_t chunk = std::min<size_t>(r.uniform_dist(100), len - pos);
+				s.update(data.data() + pos, chunk);
+				pos += chunk;
+			}
+			ASSERT_EQ(s.finish(), expected);
+
+			// Byte by byte
+			s.reset();
+			for (size_t i = 0; i < len; i++)
+				s.update(std::span<const uint8_t>(data.data() + i, 1));
+			ASSERT_EQ(s.finish(), expected);
+		}
+	}
+}
+
+TEST(wyhash, File)
+{
+	wy::rand r(0xf11e);
+	std::vector<uint8_t> data = r.generate_stream(100'000);
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "wy_hash_file_test.bin";
+
+	for (size_t len : {0, 5, 100, 4096, 100'000})
+	{
+		{
+			std::ofstream file(path, std::ios::binary);
+			ASSERT_TRUE(file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(len)));
+		}
+
+		wy::internal::hash_imp h(len);
+		ASSERT_EQ(wy::hash_file(path, h), h.wyhash(data.data(), len));
+
+		// Tree mode don't depend on the number of threads
+		uint64_t tree = wy::hash_tree(data.data(), len, 1000, 1, h);
+		ASSERT_EQ(wy::hash_tree(data.data(), len, 1000, 3, h), tree);
+		ASSERT_EQ(wy::hash_file_tree(path, 1000, 0, h), tree);
+		if (len > 999)
+		{
+			ASSERT_NE(wy::hash_tree(data.data(), len, 999, 1, h), tree);
+		}
+	}
+
+	std::filesystem::remove(path);
+	ASSERT_FALSE(wy::hash_file(path).has_value());
+}
+
+TEST(wyhash, RangeReduction)
+{
+	wy::rand r(7);
+	const uint64_t divisors[] = { 1, 2, 3, 7, 10, 1000000007ull, (1ull << 32) + 1, 1ull << 63, (1ull << 63) + 1, UINT64_MAX - 1, UINT64_MAX };
+	for (uint64_t d : divisors)
+	{
+		wy::fastmod mod(d);
+		ASSERT_EQ(mod.divisor(), d);
+		for (uint64_t a : std::initializer_list<uint64_t>{ 0, 1, d - 1, d, UINT64_MAX })
+			ASSERT_EQ(mod(a), a % d);
+		for (size_t i = 0; i < 10'000; i++)
+		{
+			uint64_t a = r() >> r.uniform_dist(64);
+			ASSERT_EQ(mod(a), a % d);
+		}
+	}
+	for (size_t i = 0; i < 1'000; i++)
+	{
+		uint64_t d = r() >> r.uniform_dist(64) | 1;
+		wy::fastmod mod(d);
+		uint64_t a = r();
+		ASSERT_EQ(mod(a), a % d);
+	}
+	ASSERT_THROW(wy::fastmod(0), std::invalid_argument);
+
+	// reduce: uniform in [0, n)
+	wy::hash<uint64_t> hasher;
+	std::vector<size_t> counts(10);
+	for (uint64_t i = 0; i < 100'000; i++)
+	{
+		uint64_t bucket = wy::reduce(hasher(i), counts.size());
+		ASSERT_LT(bucket, counts.size());
+		counts[bucket]++;
+	}
+	for (size_t count : counts)
+		ASSERT_NEAR(static_cast<double>(count), 10'000.0, 500.0);
+	ASSERT_EQ(wy::reduce(UINT64_MAX, 5), 4u);
+	ASSERT_EQ(wy::reduce(0, 5), 0u);
+
+	// Powers of two
+	static_assert(wy::is_pow2(1) && wy::is_pow2(1ull << 63) && !wy::is_pow2(0) && !wy::is_pow2(6));
+	static_assert(wy::next_pow2(0) == 1 && wy::next_pow2(5) == 8 && wy::next_pow2(8) == 8 && wy::next_pow2((1ull << 62) + 1) == 1ull << 63);
+	static_assert(wy::pow2_index(0x1234, 256) == 0x34);
+}
+
+TEST(wyrand, StreamAllocators)
+{
+	// Everything on the arena: the null upstream throws if it is exhausted
+	std::vector<std::byte> buffer(1 << 16);
+	std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+	wy::rand r1(5), r2(5);
+	std::vector<uint8_t> expected = r1.generate_stream(1001);
+	std::pmr::vector<uint8_t> stream = r2.generate_stream(1001, &arena);
+	ASSERT_EQ(stream.get_allocator().resource(), &arena);
+	ASSERT_TRUE(std::equal(stream.begin(), stream.end(), expected.begin(), expected.end()));
+
+	std::vector<uint32_t> expected32 = r1.generate_stream<uint32_t>(100);
+	std::pmr::vector<uint32_t> stream32(&arena);
+	r2.generate_stream(stream32, 100);
+	ASSERT_EQ(stream32.get_allocator().resource(), &arena);
+	ASSERT_TRUE(std::equal(stream32.begin(), stream32.end(), expected32.begin(), expected32.end()));
+
+	wy::rand_x8 l1(9), l2(9);
+	std::vector<uint64_t> expected_lanes = l1.generate_stream<uint64_t>(77);
+	std::pmr::vector<uint64_t> stream_lanes = l2.generate_stream<uint64_t>(77, &arena);
+	ASSERT_TRUE(std::equal(stream_lanes.begin(), stream_lanes.end(), expected_lanes.begin(), expected_lanes.end()));
+}
+
+TEST(wyrand, StreamLanes)
+{
+	for (uint64_t seed = 0; seed < 1'000; seed++)
+	{
+		size_t size = seed % 300;
+		wy::rand r(seed);
+		wy::rand_x4 r4(seed);
+		wy::rand_x8 r8(seed);
+
+		// Serial reference
+		std::vector<uint8_t> expected(size);
+		uint64_t originalSeed = seed;
+		for (size_t i = 0; i < size; i += sizeof(uint64_t))
+		{
+			uint64_t val = wyrand(&originalSeed);
+			for (size_t j = 0; j < sizeof(uint64_t) && i + j < size; j++)
+				expected[i + j] = static_cast<uint8_t>(val >> (j * 8));
+		}
+
+		ASSERT_EQ(r.generate_stream(size), expected);
+		ASSERT_EQ(r4.generate_stream(size), expected);
+		ASSERT_EQ(r8.generate_stream(size), expected);
+
+		std::vector<uint8_t> span_data(size);
+		wy::rand_x8(seed).generate_stream(std::span<uint8_t>(span_data));
+		ASSERT_EQ(span_data, expected);
+
+		// Same state after the stream
+		ASSERT_EQ(r.state, originalSeed);
+		ASSERT_EQ(r4.state, originalSeed);
+		ASSERT_EQ(r8.state, originalSeed);
+		ASSERT_EQ(r4(), r());
+	}
+}
+
+TEST(wyrand, CpuDispatch)
+{
+	wy::cpu_path detected = wy::detected_cpu_path();
+	ASSERT_EQ(wy::active_cpu_path(), detected);
+	ASSERT_EQ(wy::force_cpu_path(wy::cpu_path::avx512), detected);// Never more than supported
+
+	// All paths up to the detected one produce the same bytes
+	wy::force_cpu_path(wy::cpu_path::scalar);
+	ASSERT_EQ(wy::active_cpu_path(), wy::cpu_path::scalar);
+	std::vector<std::vector<uint8_t>> expected;
+	for (uint64_t seed = 0; seed < 100; seed++)
+		expected.push_back(wy::rand(seed).generate_stream(seed * 13));
+
+	for (wy::cpu_path path : { wy::cpu_path::avx2, wy::cpu_path::avx512 })
+	{
+		if (path > detected)
+			break;
+		ASSERT_EQ(wy::force_cpu_path(path), path);
+		for (uint64_t seed = 0; seed < 100; seed++)
+		{
+			wy::rand r(seed);
+			ASSERT_EQ(r.generate_stream(seed * 13), expected[seed]) << wy::cpu_path_name(path);
+			ASSERT_EQ(wy::rand_x4(seed).generate_stream(seed * 13), expected[seed]) << wy::cpu_path_name(path);
+
+			// Same state after the stream
+			wy::rand serial(seed);
+			serial.discard((seed * 13 + 7) / 8);
+			ASSERT_EQ(r.state, serial.state);
+		}
+	}
+	wy::force_cpu_path(detected);
+}
+
+TEST(wyrand, FillDistributions)
+{
+	for (uint64_t seed = 0; seed < 1'000; seed++)
+	{
+		size_t size = seed % 1100;
+		std::vector<double> values(size);
+		std::vector<uint64_t> values_k(size);
+
+		wy::rand r(seed);
+		wy::rand r0(seed);
+
+		r.fill_uniform(values);
+		for (double val : values)
+			ASSERT_EQ(val, r0.uniform_dist());
+
+		r.fill_uniform(values, -1.2, -1);
+		for (double val : values)
+			ASSERT_EQ(val, r0.uniform_dist(-1.2, -1));
+
+#if !WYHASH_32BIT_MUM
+		r.fill_uniform(values_k, 500);
+		for (uint64_t val : values_k)
+			ASSERT_EQ(val, r0.uniform_dist(500));
+#endif
+
+		r.fill_gaussian(values);
+		for (double val : values)
+			ASSERT_EQ(val, r0.gaussian_dist());
+
+		r.fill_gaussian(values, 1.1, 2.3);
+		for (double val : values)
+			ASSERT_EQ(val, r0.gaussian_dist(1.1, 2.3));
+
+		ASSERT_EQ(r.state, r0.state);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+/// Containers
+/////////////////////////////////////////////////////////////////////////////////
+#include <unordered_map>
+#include <unordered_set>
+
+TEST(flat_map, CompareWithUnorderedMap)
+{
+	wy::rand r(0xf1a7);
+	wy::flat_map<uint64_t, uint64_t> m;
+	std::unordered_map<uint64_t, uint64_t> expected;
+	ASSERT_TRUE(m.empty());
+	ASSERT_EQ(m.find(7), m.end());
+	ASSERT_EQ(m.begin(), m.end());
+
+	for (size_t i = 0; i < 200'000; i++)
+	{
+		uint64_t key = r.uniform_dist(5'000);
+		switch (r.uniform_dist(4))
+		{
+		case 0:
+		case 1:
+			ASSERT_EQ(m.insert({ key, i }).second, expected.insert({ key, i }).second);
+			break;
+		case 2:
+			ASSERT_EQ(m.erase(key), expected.erase(key));
+			break;
+		case 3:
+			m[key] = i;
+			expected[key] = i;
+			break;
+		}
+		ASSERT_EQ(m.size(), expected.size());
+
+		uint64_t lookup = r.uniform_dist(5'000);
+		auto it = m.find(lookup);
+		auto expected_it = expected.find(lookup);
+		ASSERT_EQ(it == m.end(), expected_it == expected.end());
+		if (it != m.end())
+		{
+			ASSERT_EQ(it->second, expected_it->second);
+		}
+	}
+	ASSERT_LE(m.load_factor(), m.max_load_factor());
+
+	// Iteration
+	size_t count = 0;
+	for (const auto& [key, value] : m)
+	{
+		ASSERT_EQ(expected.at(key), value);
+		count++;
+	}
+	ASSERT_EQ(count, expected.size());
+
+	// Erase while iterating
+	for (auto it = m.begin(); it != m.end();)
+	{
+		if (it->first % 2) { expected.erase(it->first); it = m.erase(it); }
+		else ++it;
+	}
+	ASSERT_EQ(m.size(), expected.size());
+	for (const auto& [key, value] : expected)
+		ASSERT_EQ(m.at(key), value);
+
+	m.clear();
+	ASSERT_TRUE(m.empty());
+	ASSERT_EQ(m.begin(), m.end());
+	ASSERT_THROW(m.at(1), std::out_of_range);
+}
+
+TEST(flat_map, StringKeysCopyMove)
+{
+	wy::flat_map<std::string, size_t> m;
+	for (size_t i = 0; i < 1'000; i++)
+		ASSERT_TRUE(m.try_emplace("key " + std::to_string(i), i).second);
+	ASSERT_FALSE(m.try_emplace("key 7", 0).second);
+	ASSERT_FALSE(m.insert_or_assign("key 7", 70).second);
+	ASSERT_EQ(m["key 7"], 70);
+
+	wy::flat_map<std::string, size_t> copy = m;
+	ASSERT_EQ(copy, m);
+	wy::flat_map<std::string, size_t> moved = std::move(copy);
+	ASSERT_EQ(moved, m);
+	ASSERT_TRUE(copy.empty());
+	copy = moved;
+	ASSERT_EQ(copy, m);
+	moved.erase("key 8");
+	ASSERT_NE(moved, m);
+	ASSERT_EQ(moved.count("key 8"), 0);
+	ASSERT_EQ(m.count("key 8"), 1);
+}
+
+TEST(flat_map, Pmr)
+{
+	std::vector<std::byte> buffer(1 << 20);
+	std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+	wy::pmr::flat_map<std::pmr::string, int> m(&arena);
+	for (int i = 0; i < 1000; i++)
+		m.try_emplace(std::pmr::string("a key longer than the small buffer " + std::to_string(i), &arena), i);
+	ASSERT_EQ(m.size(), 1000u);
+	ASSERT_EQ(m.get_allocator().resource(), &arena);
+	for (const auto& [key, value] : m)
+	{
+		ASSERT_EQ(key.get_allocator().resource(), &arena);// Uses-allocator construction of the elements
+		ASSERT_EQ(std::string_view(key), "a key longer than the small buffer " + std::to_string(value));
+	}
+	ASSERT_EQ(m.at(std::pmr::string("a key longer than the small buffer 7", &arena)), 7);
+
+	wy::pmr::flat_set<uint64_t> s(&arena);
+	for (uint64_t i = 0; i < 1000; i++) s.insert(i * 3);
+	ASSERT_EQ(s.size(), 1000u);
+	ASSERT_TRUE(s.contains(999));
+	ASSERT_FALSE(s.contains(1000));
+}
+
+TEST(flat_map, BatchFind)
+{
+	for (uint64_t num_elements : { 100ull, 200'000ull })// On cache and prefetched
+	{
+		wy::flat_map<uint64_t, uint64_t> m;
+		std::unordered_map<uint64_t, uint64_t, wy::hash<uint64_t>> um;
+		for (uint64_t i = 0; i < num_elements; i++) { m[i * 2] = i; um[i * 2] = i; }
+		ASSERT_EQ(m.size_in_bytes() > (1 << 20), num_elements > 100);
+
+		std::vector<uint64_t> keys(1000);
+		wy::rand r;
+		for (uint64_t& key : keys) key = r.uniform_dist(num_elements * 2);
+		std::vector<wy::flat_map<uint64_t, uint64_t>::iterator> out(keys.size());
+		size_t num_found = wy::batch_find(m, keys, out);
+		size_t expected_found = 0;
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			ASSERT_EQ(out[i], m.find(keys[i]));
+			expected_found += out[i] != m.end();
+		}
+		ASSERT_EQ(num_found, expected_found);
+
+		// Const containers and containers without prefetch
+		const wy::flat_map<uint64_t, uint64_t>& cm = m;
+		std::vector<wy::flat_map<uint64_t, uint64_t>::const_iterator> cout(keys.size());
+		ASSERT_EQ(wy::batch_find(cm, keys, cout), expected_found);
+		std::vector<std::unordered_map<uint64_t, uint64_t, wy::hash<uint64_t>>::iterator> uout(keys.size());
+		ASSERT_EQ(wy::batch_find(um, keys, uout), expected_found);
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			ASSERT_EQ(cout[i], m.find(keys[i]));
+			ASSERT_EQ(uout[i], um.find(keys[i]));
+		}
+
+		// The pipeline step by step
+		std::vector<uint64_t> hashes(keys.size());
+		wy::hash_all(m, keys, hashes);
+		ASSERT_EQ(hashes[3], wy::hash<uint64_t>()(keys[3]));
+		wy::prefetch(m, hashes);
+		ASSERT_EQ(wy::resolve(m, keys, hashes, out), expected_found);
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			ASSERT_EQ(out[i], m.find(keys[i]));
+			ASSERT_EQ(m.contains(keys[i], hashes[i]), m.contains(keys[i]));
+		}
+	}
+
+	wy::flat_set<std::string> s = { "a", "bb", "ccc" };
+	std::vector<std::string> keys = { "bb", "d", "a" };
+	std::vector<wy::flat_set<std::string>::const_iterator> out(keys.size());
+	ASSERT_EQ(wy::batch_find(s, keys, out), 2u);
+	ASSERT_EQ(*out[0], "bb");
+	ASSERT_EQ(out[1], s.end());
+	ASSERT_EQ(s.find(std::string_view("ccc"), wy::hash<std::string>()("ccc")), s.find("ccc"));
+	wy::flat_set<std::string> empty;
+	empty.prefetch(123);
+	ASSERT_EQ(empty.find("a", 123), empty.end());
+}
+
+// The statistics recorded with WY_INSTRUMENT 1 are tested on 'tests_instrument.cpp'
+TEST(flat_map, HashStats)
+{
+	// WY_INSTRUMENT 0: only forwards to the hasher
+	static_assert(WY_INSTRUMENT == 0);
+	wy::flat_map<std::string, int, wy::hash_stats<wy::hash<std::string>>> m;
+	ASSERT_EQ(m.hash_function().stats(), nullptr);
+	for (int i = 0; i < 10'000; i++)
+		m[std::to_string(i)] = i;
+	ASSERT_EQ(m.hash_function()("123"), wy::hash<std::string>()("123"));
+	ASSERT_TRUE(m.contains(std::string_view("123")));// Transparent as wy::hash<std::string>
+	ASSERT_EQ(m.hash_function().stats(), nullptr);
+
+	// Most elements on their home group
+	std::vector<size_t> probes = m.probe_histogram();
+	ASSERT_EQ(std::accumulate(probes.begin(), probes.end(), size_t(0)), m.size());
+	ASSERT_GT(probes[0], m.size() * 9 / 10);
+
+	// A bad hash clusters: only multiples of 1024
+	struct bad_hash { uint64_t operator()(uint64_t key) const noexcept { return (key % 64) << 10; } };
+	wy::flat_set<uint64_t, wy::hash_stats<bad_hash>> bad_set;
+	for (uint64_t i = 0; i < 64; i++) bad_set.insert(i);
+	ASSERT_GT(bad_set.probe_histogram().size(), 1u);
+}
+
+TEST(concurrent_map, Basic)
+{
+	wy::concurrent_map<std::string, int> m(5);
+	ASSERT_EQ(m.num_shards(), 8u);
+	ASSERT_TRUE(m.empty());
+
+	ASSERT_TRUE(m.try_emplace("one", 1));
+	ASSERT_FALSE(m.try_emplace("one", 10));
+	ASSERT_TRUE(m.insert({ "two", 2 }));
+	ASSERT_TRUE(m.insert_or_assign("three", 3));
+	ASSERT_FALSE(m.insert_or_assign("three", 30));
+	ASSERT_EQ(m.size(), 3u);
+
+	ASSERT_EQ(m.find("one"), std::optional<int>(1));
+	ASSERT_EQ(m.find(std::string_view("three")), std::optional<int>(30));// Transparent lookup
+	ASSERT_FALSE(m.find("four").has_value());
+	ASSERT_TRUE(m.contains("two"));
+	ASSERT_TRUE(m.update("two", [](int& value) { value *= 10; }));
+	ASSERT_FALSE(m.update("four", [](int& value) { value = 0; }));
+	int seen = 0;
+	ASSERT_TRUE(m.visit("two", [&](const int& value) { seen = value; }));
+	ASSERT_EQ(seen, 20);
+
+	int sum = 0;
+	m.for_each([&](const std::string& key, int value) { sum += value; ASSERT_FALSE(key.empty()); });
+	ASSERT_EQ(sum, 1 + 20 + 30);
+
+	ASSERT_TRUE(m.erase("one"));
+	ASSERT_FALSE(m.erase(std::string_view("one")));
+	ASSERT_FALSE(m.contains("one"));
+	ASSERT_EQ(m.size(), 2u);
+	m.clear();
+	ASSERT_TRUE(m.empty());
+
+	// Many elements over the shards, against std::unordered_map
+	wy::concurrent_map<uint64_t, uint64_t> big;
+	ASSERT_TRUE(wy::is_pow2(big.num_shards()));
+	big.reserve(10'000);
+	std::unordered_map<uint64_t, uint64_t> expected;
+	wy::rand r;
+	for (size_t i = 0; i < 20'000; i++)
+	{
+		uint64_t key = r.uniform_dist(10'000);
+		if (r.uniform_dist(4) == 0)
+			ASSERT_EQ(big.erase(key), expected.erase(key) == 1);
+		else
+			ASSERT_EQ(big.insert_or_assign(key, i), expected.insert_or_assign(key, i).second);
+	}
+	ASSERT_EQ(big.size(), expected.size());
+	for (const auto& [key, value] : expected)
+		ASSERT_EQ(big.find(key), std::optional<uint64_t>(value));
+}
+
+TEST(concurrent_map, Threads)
+{
+	constexpr uint64_t num_threads = 4;
+	constexpr uint64_t keys_by_thread = 20'000;
+	wy::concurrent_map<uint64_t, uint64_t> m(4);// Few shards: the threads rehash tables others read
+	std::atomic<uint64_t> num_bad_reads = 0;
+
+	std::vector<std::thread> threads;
+	for (uint64_t t = 0; t < num_threads; t++)
+		threads.emplace_back([&, t]() {
+			wy::rand r(t);
+			for (uint64_t i = 0; i < keys_by_thread; i++)
+			{
+				uint64_t key = i * num_threads + t;// Keys owned by this thread
+				m.try_emplace(key, key * 2);
+				if (i % 4 == 3) m.erase(key - 2 * num_threads);
+
+				std::optional<uint64_t> other = m.find(r.uniform_dist(keys_by_thread * num_threads));// Keys of any thread
+				if (other.has_value() && other.value() % 2) num_bad_reads++;
+				m.update(r.uniform_dist(keys_by_thread * num_threads), [](uint64_t& value) { value += 2; });
+			}
+		});
+	for (std::thread& t : threads)
+		t.join();
+
+	ASSERT_EQ(num_bad_reads, 0u);
+	ASSERT_EQ(m.size(), num_threads * keys_by_thread * 3 / 4);
+	for (uint64_t key = 0; key < num_threads * keys_by_thread; key++)
+		ASSERT_EQ(m.contains(key), (key / num_threads) % 4 != 1);
+}
+
+TEST(flat_set, Basic)
+{
+	wy::flat_set<uint32_t> s = { 1, 2, 3 };
+	std::unordered_set<uint32_t> expected = { 1, 2, 3 };
+	ASSERT_FALSE(s.insert(2).second);
+	for (uint32_t i = 0; i < 10'000; i++)
+	{
+		uint32_t key = i * 7 % 3'001;
+		ASSERT_EQ(s.insert(key).second, expected.insert(key).second);
+		if (i % 3 == 0) { ASSERT_EQ(s.erase(key / 2), expected.erase(key / 2)); }
+	}
+	ASSERT_EQ(s.size(), expected.size());
+	for (uint32_t key : expected)
+		ASSERT_TRUE(s.contains(key));
+	for (uint32_t key : s)
+		ASSERT_EQ(expected.count(key), 1);
+}
+
+TEST(wyhash, TransparentStrings)
+{
+	const char* c_str = "an example to hash transparently, longer than the SSO";
+	std::string str = c_str;
+	std::string_view view = c_str;
+	std::pmr::string pmr_str = c_str;
+
+	wy::hash<std::string> h;
+	uint64_t expected = h(str);
+	ASSERT_EQ(h(c_str), expected);
+	ASSERT_EQ(h(view), expected);
+	ASSERT_EQ(h(pmr_str), expected);
+	ASSERT_EQ(wy::hash<std::string_view>()(str), expected);
+	ASSERT_EQ(wy::hash<std::pmr::string>()(view), expected);
+	ASSERT_EQ(wy::hash<std::u16string>()(u"wide"), wy::hash<std::u16string_view>()(std::u16string(u"wide")));
+
+	// Lookups without a temporary std::string
+	std::unordered_map<std::string, int, wy::hash<std::string>, std::equal_to<>> map = { { str, 1 } };
+	ASSERT_EQ(map.find(view)->second, 1);
+	ASSERT_EQ(map.find(c_str)->second, 1);
+	ASSERT_EQ(map.count(std::string_view(pmr_str)), 1);
+
+	wy::flat_map<std::string, int> flat = { { str, 2 } };
+	ASSERT_EQ(flat.find(view)->second, 2);
+	ASSERT_TRUE(flat.contains(c_str));
+	ASSERT_EQ(flat.erase(std::string_view(pmr_str)), 1);
+	ASSERT_TRUE(flat.empty());
+}
+
+TEST(wyhash, CompileTime)
+{
+	using namespace wy::literals;
+	static_assert(wy::hash_ct("key") == "key"_wyh);
+	static constexpr uint64_t table[] = { "get"_wyh, "put"_wyh, "delete"_wyh };
+
+	wy::hash<std::string> h;
+	ASSERT_EQ(h("put"), table[1]);
+
+	// All the size paths of wyhash: 0, 1-3, 4-16, 17-48, >48
+	std::string str;
+	for (size_t i = 0; i < 200; i++)
+	{
+		ASSERT_EQ(wy::hash_ct(str), h(str));
+		str.push_back(static_cast<char>(i * 37 + 200));// Include bytes >= 128
+	}
+
+	int command = 0;
+	switch (h(std::string_view("delete")))
+	{
+	case "get"_wyh: command = 1; break;
+	case "delete"_wyh: command = 3; break;
+	default: break;
+	}
+	ASSERT_EQ(command, 3);
+}
+
+TEST(perfect_hash_map, Basic)
+{
+	std::vector<std::pair<std::string, size_t>> elems;
+	for (size_t i = 0; i < 20000; i++)
+		elems.emplace_back("token " + std::to_string(i * 7919), i);
+	elems.emplace_back("token 0", 12345);// Repeated keys keep the first value
+
+	wy::perfect_hash_map<std::string, size_t> map(elems.begin(), elems.end());
+	ASSERT_EQ(map.size(), 20000);
+	for (size_t i = 0; i < 20000; i++)
+	{
+		auto it = map.find(elems[i].first);
+		ASSERT_NE(it, map.end());
+		ASSERT_EQ(it->first, elems[i].first);
+		ASSERT_EQ(it->second, i);
+	}
+	ASSERT_EQ(map.at(std::string("token 0")), 0);
+	ASSERT_FALSE(map.contains(std::string("token 1")));
+	ASSERT_EQ(map.find(std::string_view("token 7919"))->second, 1);// Heterogeneous lookup
+	ASSERT_TRUE(map.contains("token 15838"));
+	ASSERT_THROW(map.at(std::string("unknown")), std::out_of_range);
+
+	// All slots are used: a minimal perfect hash
+	size_t sum = 0;
+	for (const auto& elem : map)
+		sum += elem.second;
+	ASSERT_EQ(sum, size_t(20000) * 19999 / 2);
+
+	// Small and empty maps
+	wy::perfect_hash_map<uint64_t, int> small = { { 1, 10 }, { 2, 20 }, { 3, 30 } };
+	ASSERT_EQ(small.size(), 3);
+	ASSERT_EQ(small.at(2), 20);
+	ASSERT_EQ(small.count(4), 0);
+	small.find(3)->second = 31;
+	ASSERT_EQ(small.at(3), 31);
+
+	wy::perfect_hash_map<uint64_t, int> empty;
+	ASSERT_TRUE(empty.empty());
+	ASSERT_EQ(empty.find(1), empty.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Filters
+////////////////////////////////////////////////////////////////////////////////////
+TEST(bloom_filter, Basic)
+{
+	wy::rand r(21);
+	std::vector<uint64_t> keys(20000), others(100000);
+	for (auto& key : keys) key = r();
+	for (auto& key : others) key = r();
+
+	wy::bloom_filter<uint64_t> filter(keys.size(), 0.01);
+	for (size_t i = 0; i < keys.size() / 2; i++)
+		filter.insert(keys[i]);
+	filter.insert(std::span<const uint64_t>(keys).subspan(keys.size() / 2));
+
+	// No false negatives
+	for (uint64_t key : keys)
+		ASSERT_TRUE(filter.contains(key));
+
+	// False positives near the rate asked
+	size_t false_positives = 0;
+	for (uint64_t key : others)
+		false_positives += filter.contains(key);
+	ASSERT_LT(false_positives, others.size() * 2 / 100);
+
+	// Batch lookups give the same results
+	std::unique_ptr<bool[]> results(new bool[others.size()]);
+	ASSERT_EQ(filter.contains(others, std::span<bool>(results.get(), others.size())), false_positives);
+	for (size_t i = 0; i < others.size(); i++)
+		ASSERT_EQ(results[i], filter.contains(others[i]));
+
+	// Strings and merge
+	wy::bloom_filter<std::string> a(100), b(100);
+	a.insert("first");
+	b.insert("second");
+	a.merge(b);
+	ASSERT_TRUE(a.contains("first"));
+	ASSERT_TRUE(a.contains("second"));
+	a.clear();
+	ASSERT_FALSE(a.contains("first"));
+
+	// Invalid false positive rates
+	ASSERT_THROW(wy::bloom_filter<uint64_t>(100, 0.0), std::invalid_argument);
+	ASSERT_THROW(wy::bloom_filter<uint64_t>(100, 1.0), std::invalid_argument);
+	ASSERT_THROW(wy::bloom_filter<uint64_t>(100, -0.5), std::invalid_argument);
+	ASSERT_THROW(wy::bloom_filter<uint64_t>(100, std::nan("")), std::invalid_argument);
+}
+
+TEST(cuckoo_filter, Basic)
+{
+	wy::rand r(22);
+	std::vector<uint64_t> keys(20000), others(100000);
+	for (auto& key : keys) key = r();
+	for (auto& key : others) key = r();
+
+	wy::cuckoo_filter<uint64_t> filter(keys.size());
+	ASSERT_EQ(filter.insert(std::span<const uint64_t>(keys)), keys.size());
+	ASSERT_EQ(filter.size(), keys.size());
+	for (uint64_t key : keys)
+		ASSERT_TRUE(filter.contains(key));
+
+	size_t false_positives = 0;
+	for (uint64_t key : others)
+		false_positives += filter.contains(key);
+	ASSERT_LT(false_positives, others.size() / 1000);
+
+	std::unique_ptr<bool[]> results(new bool[keys.size()]);
+	ASSERT_EQ(filter.contains(keys, std::span<bool>(results.get(), keys.size())), keys.size());
+
+	// Deletion
+	for (size_t i = 0; i < keys.size(); i += 2)
+		ASSERT_TRUE(filter.erase(keys[i]));
+	ASSERT_EQ(filter.size(), keys.size() / 2);
+	for (size_t i = 1; i < keys.size(); i += 2)
+		ASSERT_TRUE(filter.contains(keys[i]));
+	size_t erased_found = 0;
+	for (size_t i = 0; i < keys.size(); i += 2)
+		erased_found += filter.contains(keys[i]);
+	ASSERT_LT(erased_found, keys.size() / 1000);
+
+	// Full filter: inserted keys are never lost
+	wy::cuckoo_filter<uint64_t> small(100);
+	size_t inserted = 0;
+	while (small.insert(keys[inserted])) inserted++;
+	ASSERT_GE(inserted, small.capacity() * 9 / 10);
+	for (size_t i = 0; i <= inserted; i++)
+		ASSERT_TRUE(small.contains(keys[i]));
+	ASSERT_FALSE(small.insert(keys[inserted + 1]));
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Cardinality estimation
+////////////////////////////////////////////////////////////////////////////////////
+TEST(hyperloglog, Estimate)
+{
+	// Small sets are sparse and nearly exact
+	wy::hyperloglog<uint64_t> small;
+	for (uint64_t i = 0; i < 1000; i++)
+	{
+		small.add(i);
+		small.add(i);// Repeated keys are counted once
+	}
+	ASSERT_TRUE(small.is_sparse());
+	ASSERT_NEAR(small.estimate(), 1000, 5);
+
+	// Big sets: error within 4 standard errors
+	for (uint64_t n : { 5000, 100000, 2000000 })
+	{
+		wy::hyperloglog<uint64_t> sketch;
+		std::vector<uint64_t> keys(n);
+		for (uint64_t i = 0; i < n; i++)
+			keys[i] = i * 0x9e3779b97f4a7c15ull;
+		sketch.add(keys);
+		ASSERT_FALSE(sketch.is_sparse());
+		ASSERT_NEAR(sketch.estimate(), static_cast<double>(n), 4 * 1.04 / 128 * n);
+	}
+
+	wy::hyperloglog<std::string, 10> strings;
+	ASSERT_EQ(strings.estimate(), 0);
+	strings.add("first");
+	strings.add("second");
+	ASSERT_NEAR(strings.estimate(), 2, 0.01);
+	strings.clear();
+	ASSERT_EQ(strings.estimate(), 0);
+}
+
+TEST(hyperloglog, Merge)
+{
+	// Shards merged give the same registers as one sketch, whether sparse or dense
+	for (uint64_t n : { 100, 1000, 3000, 200000 })
+	{
+		wy::hyperloglog<uint64_t> all, shards[4];
+		for (uint64_t i = 0; i < n; i++)
+		{
+			all.add(i);
+			shards[i % 4].add(i);
+			shards[(i + 1) % 4].add(i);// Also keys on many shards
+		}
+		wy::hyperloglog<uint64_t> merged;
+		for (const auto& shard : shards)
+			merged.merge(shard);
+
+		ASSERT_EQ(merged.is_sparse(), all.is_sparse());
+		ASSERT_EQ(merged.estimate(), all.estimate());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////
+// Consistent hashing
+////////////////////////////////////////////////////////////////////////////////////
+TEST(consistent_hashing, JumpHash)
+{
+	const size_t num_keys = 100000;
+	std::vector<int32_t> previous(num_keys, 0);
+	for (int32_t buckets = 1; buckets <= 40; buckets++)
+	{
+		std::vector<size_t> counts(buckets);
+		size_t moved = 0;
+		for (size_t i = 0; i < num_keys; i++)
+		{
+			int32_t bucket = wy::jump_hash(wy::internal::wyhash64(i, 0), buckets);
+			ASSERT_GE(bucket, 0);
+			ASSERT_LT(bucket, buckets);
+			// Keys only move to the new bucket
+			if (bucket != previous[i]) { ASSERT_EQ(bucket, buckets - 1); moved++; }
+			previous[i] = bucket;
+			counts[bucket]++;
+		}
+		if (buckets > 1) { ASSERT_NEAR(static_cast<double>(moved), static_cast<double>(num_keys) / buckets, num_keys * 0.01); }
+		for (size_t count : counts)
+			ASSERT_NEAR(static_cast<double>(count), static_cast<double>(num_keys) / buckets, num_keys * 0.01);
+	}
+	ASSERT_EQ(wy::jump_hash(12345, 1), 0);
+
+	// Many buckets: the jumps of small uniforms are out of int64_t range
+	for (uint64_t i = 0; i < 10000; i++)
+	{
+		int32_t bucket = wy::jump_hash(wy::internal::wyhash64(i, 0), INT32_MAX);
+		ASSERT_GE(bucket, 0);
+		ASSERT_LT(bucket, INT32_MAX);
+	}
+}
+
+TEST(consistent_hashing, Rendezvous)
+{
+	const size_t num_keys = 100000;
+	wy::hash<std::string> h;
+
+	wy::rendezvous_router<std::string> router;
+	for (int i = 0; i < 8; i++)
+		router.add("node " + std::to_string(i));
+	router.add("node 0");// Repeated nodes are not added
+	ASSERT_EQ(router.size(), 8);
+
+	std::vector<std::string> before(num_keys);
+	std::vector<size_t> counts(8);
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		before[i] = router.route(h(std::to_string(i)));
+		counts[router.route_index(h(std::to_string(i)))]++;
+	}
+	for (size_t count : counts)
+		ASSERT_NEAR(static_cast<double>(count), num_keys / 8.0, num_keys * 0.01);
+
+	// Removing a node only moves its keys
+	ASSERT_TRUE(router.remove("node 3"));
+	ASSERT_FALSE(router.remove("node 3"));
+	for (size_t i = 0; i < num_keys; i++)
+		if (before[i] != "node 3")
+			ASSERT_EQ(router.route(h(std::to_string(i))), before[i]);
+		else
+			ASSERT_NE(router.route(h(std::to_string(i))), "node 3");
+
+	// Weights
+	wy::rendezvous_router<uint64_t> weighted;
+	weighted.add(1, 1.0);
+	weighted.add(2, 3.0);
+	size_t count2 = 0;
+	for (size_t i = 0; i < num_keys; i++)
+		count2 += weighted.route(wy::internal::wyhash64(i, 0)) == 2;
+	ASSERT_NEAR(static_cast<double>(count2), num_keys * 0.75, num_keys * 0.01);
+}
+
+TEST(wyhash, Composite)
+{
+	enum class shard_kind : uint32_t { primary = 1, replica = 2 };
+	std::tuple<uint64_t, std::string, uint32_t, shard_kind> key = { 42, "/var/data", 7, shard_kind::replica };
+
+	wy::hash<decltype(key)> h;
+	uint64_t manual = wy::internal::default_secret[0];
+	wy::hash_combine(manual, uint64_t(42), std::string("/var/data"), uint32_t(7), shard_kind::replica);
+	ASSERT_EQ(h(key), manual);
+
+	// Field order and values matter
+	uint64_t swapped = wy::internal::default_secret[0];
+	wy::hash_combine(swapped, uint32_t(7), std::string("/var/data"), uint64_t(42), shard_kind::replica);
+	ASSERT_NE(swapped, manual);
+	std::get<2>(key) = 8;
+	ASSERT_NE(h(key), manual);
+
+	// std::pair gives the same as the tuple
+	wy::hash<std::pair<int, std::string>> h_pair;
+	wy::hash<std::tuple<int, std::string>> h_tuple;
+	ASSERT_EQ(h_pair({ 5, "five" }), h_tuple({ 5, "five" }));
+
+	// Seeded hashers give other values
+	wy::hash<std::pair<int, std::string>> h_seed(17);
+	ASSERT_NE(h_pair({ 5, "five" }), h_seed({ 5, "five" }));
+
+	// Fields bigger than 8 bytes are hashed with the secret of the seed: seeding protects composite keys too
+	for (uint64_t seed : { 17ull, 18ull })
+	{
+		wy::secret secret = wy::secret::from_seed(seed);
+		wy::internal::hash_imp mixer(secret);
+		uint64_t salted = mixer.combine(mixer.combine(secret.words[0], 5), wy::hash<std::string>(seed)("five"));
+		wy::hash<std::pair<int, std::string>> seeded_pair(seed);
+		wy::hash<std::tuple<int, std::string>> seeded_tuple(seed);
+		ASSERT_EQ(seeded_pair({ 5, "five" }), salted);
+		ASSERT_EQ(seeded_tuple({ 5, "five" }), salted);
+		uint64_t combined = secret.words[0];
+		wy::hash_combine(secret, combined, 5, std::string("five"));
+		ASSERT_EQ(combined, salted);
+
+		uint64_t unsalted = mixer.combine(mixer.combine(secret.words[0], 5), wy::hash<std::string>()("five"));
+		ASSERT_NE(salted, unsalted);
+	}
+
+	// Composite keys on containers
+	wy::flat_map<std::pair<uint64_t, std::string>, int> map;
+	for (int i = 0; i < 1000; i++)
+		map[{ uint64_t(i % 10), std::to_string(i) }] = i;
+	ASSERT_EQ(map.size(), 1000);
+	ASSERT_EQ(map.at({ 3, "123" }), 123);
+}
+
+struct padded_key { uint8_t kind; uint64_t id; uint16_t shard; };// 13 bytes of padding
+struct dense_key { uint32_t a; uint32_t b; };
+struct nested_key { padded_key inner; double weight; std::string name; };
+struct declared_key { uint64_t id; uint8_t kind; int cached_length; };
+inline auto wy_fields(const declared_key& k) { return std::tie(k.id, k.kind); }// 'cached_length' is not part of the key
+
+TEST(wyhash, Aggregates)
+{
+	static_assert(wy::internal::num_fields<padded_key>() == 3 && wy::internal::num_fields<nested_key>() == 3);
+
+	// Equal keys with different padding bytes
+	padded_key k1, k2;
+	memset(&k1, 0x00, sizeof(k1));
+	memset(&k2, 0xff, sizeof(k2));
+	k1.kind = k2.kind = 3; k1.id = k2.id = 0x123456789; k1.shard = k2.shard = 9;
+	wy::aggregate_hash<padded_key> h;
+	ASSERT_EQ(h(k1), h(k2));
+	ASSERT_NE(wy::hash<padded_key>()(k1), wy::hash<padded_key>()(k2));// The bytes include the padding
+	std::tuple<uint8_t, uint64_t, uint16_t> fields = { 3, 0x123456789, 9 };
+	ASSERT_EQ(h(k1), wy::hash<decltype(fields)>()(fields));
+	k2.shard = 10;
+	ASSERT_NE(h(k1), h(k2));
+
+	// Without padding: the bytes, as wy::hash
+	dense_key d = { 1, 2 };
+	ASSERT_EQ(wy::aggregate_hash<dense_key>()(d), wy::hash<dense_key>()(d));
+
+	// Nested aggregates are walked too
+	nested_key n1 = { k1, 0.5, "name" }, n2 = { k1, 0.5, "name" };
+	memset(&n2.inner, 0xff, sizeof(n2.inner));
+	n2.inner.kind = 3; n2.inner.id = 0x123456789; n2.inner.shard = 9;
+	wy::aggregate_hash<nested_key> hn;
+	ASSERT_EQ(hn(n1), hn(n2));
+	n2.name = "other";
+	ASSERT_NE(hn(n1), hn(n2));
+
+	// long double: 6 bytes of padding on x86-64, hashed by value. Same for the zeros
+	struct long_double_key { long double x; };
+	struct char_long_double_key { char c; long double x; };
+	long_double_key l1, l2;
+	char_long_double_key cl1, cl2;
+	memset(&l1, 0x00, sizeof(l1)); memset(&l2, 0xff, sizeof(l2));
+	memset(&cl1, 0x00, sizeof(cl1)); memset(&cl2, 0xff, sizeof(cl2));
+	l1.x = l2.x = 1.5L;
+	cl1.c = cl2.c = 'a'; cl1.x = 1.5L; cl2.x = 1.5L;
+	ASSERT_EQ(wy::aggregate_hash<long_double_key>()(l1), wy::aggregate_hash<long_double_key>()(l2));
+	ASSERT_EQ(wy::aggregate_hash<char_long_double_key>()(cl1), wy::aggregate_hash<char_long_double_key>()(cl2));
+	l2.x = 1.5L + std::numeric_limits<long double>::epsilon();// Only the low bits of the significand differ
+	ASSERT_NE(wy::aggregate_hash<long_double_key>()(l1), wy::aggregate_hash<long_double_key>()(l2));
+	l1.x = 0.0L; l2.x = -0.0L;
+	ASSERT_EQ(wy::aggregate_hash<long_double_key>()(l1), wy::aggregate_hash<long_double_key>()(l2));
+
+	// Field list declared: used by wy::hash and wy::aggregate_hash
+	declared_key c1 = { 7, 1, 10 }, c2 = { 7, 1, 20 };
+	ASSERT_EQ(wy::hash<declared_key>()(c1), wy::hash<declared_key>()(c2));
+	std::tuple<uint64_t, uint8_t> declared_fields = { 7, 1 };
+	ASSERT_EQ(wy::hash<declared_key>()(c1), wy::hash<decltype(declared_fields)>()(declared_fields));
+	ASSERT_EQ(wy::aggregate_hash<declared_key>()(c1), wy::hash<declared_key>()(c1));
+
+	// Seeded and on containers
+	ASSERT_NE(wy::aggregate_hash<padded_key>(17)(k1), h(k1));
+	// All the nested fields are hashed with the seeded secret, as the seeded std::tuple of the fields
+	using nested_fields = std::tuple<uint64_t, double, std::string>;
+	wy::hash<nested_fields> seeded_fields(17);
+	ASSERT_EQ(wy::aggregate_hash<nested_key>(17)(n1), seeded_fields(nested_fields(wy::aggregate_hash<padded_key>(17)(k1), 0.5, "name")));
+	ASSERT_NE(wy::aggregate_hash<nested_key>(17)(n1), seeded_fields(nested_fields(wy::aggregate_hash<padded_key>(17)(k1), 0.5, "other")));
+	struct key_equal { bool operator()(const padded_key& a, const padded_key& b) const noexcept { return a.kind == b.kind && a.id == b.id && a.shard == b.shard; } };
+	wy::flat_set<padded_key, wy::aggregate_hash<padded_key>, key_equal> set;
+	set.insert(k1);
+	ASSERT_TRUE(set.contains(padded_key{ 3, 0x123456789, 9 }));
+}
+
+struct case_insensitive_traits : std::char_traits<char> {};
+
+TEST(wyhash, Ranges)
+{
+	wy::internal::hash_imp h;
+	std::vector<int> vector = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+	uint64_t expected = h.wyhash(reinterpret_cast<const uint8_t*>(vector.data()), vector.size() * sizeof(int));
+
+	// Contiguous ranges are hashed in place
+	wy::hash<std::vector<int>> h_vector;
+	wy::hash<std::span<const int>> h_span;
+	wy::hash<std::span<int, 20>> h_span_fixed;
+	ASSERT_EQ(h_vector(vector), expected);
+	ASSERT_EQ(h_span(std::span<const int>(vector)), expected);
+	ASSERT_EQ(h_span_fixed(std::span<int, 20>(vector.data(), 20)), expected);
+
+	std::basic_string_view<char, case_insensitive_traits> custom_view("custom traits view");
+	wy::hash<decltype(custom_view)> h_custom;
+	ASSERT_EQ(h_custom(custom_view), wy::hash<std::string_view>()("custom traits view"));
+
+	// Non-contiguous ranges are streamed, with the same hash for the same elements
+	std::list<int> list(vector.begin(), vector.end());
+	std::deque<int> deque(vector.begin(), vector.end());
+	wy::hash<std::list<int>> h_list;
+	wy::hash<std::deque<int>> h_deque;
+	ASSERT_EQ(h_list(list), expected);
+	ASSERT_EQ(h_deque(deque), expected);
+	std::deque<uint64_t> big(1000);
+	for (size_t i = 0; i < big.size(); i++)
+		big[i] = i * 0x9e3779b97f4a7c15ull;
+	std::vector<uint64_t> big_vector(big.begin(), big.end());
+	wy::hash<std::deque<uint64_t>> h_big;
+	ASSERT_EQ(h_big(big), h.wyhash(reinterpret_cast<const uint8_t*>(big_vector.data()), big_vector.size() * sizeof(uint64_t)));
+
+	// Elements that can't be hashed as bytes are combined, the same on all containers
+	std::vector<std::string> strings = { "one", "two", "three" };
+	std::list<std::string> string_list(strings.begin(), strings.end());
+	std::array<std::string, 3> string_array = { "one", "two", "three" };
+	wy::hash<std::vector<std::string>> h_strings;
+	wy::hash<std::list<std::string>> h_string_list;
+	wy::hash<std::array<std::string, 3>> h_string_array;
+	ASSERT_EQ(h_strings(strings), h_string_list(string_list));
+	ASSERT_EQ(h_strings(strings), h_string_array(string_array));
+	std::vector<std::string> copy = strings;
+	ASSERT_EQ(h_strings(copy), h_strings(strings));
+	copy[1] = "2";
+	ASSERT_NE(h_strings(copy), h_strings(strings));
+
+	// Seeded: each element is hashed with the seeded secret, on both paths
+	wy::internal::hash_imp mixer(17);
+	uint64_t salted = mixer.secret[0];
+	for (const std::string& s : strings) salted = mixer.combine(salted, wy::hash<std::string>(17)(s));
+	salted = mixer.combine(salted, strings.size());
+	wy::hash<std::vector<std::string>> h_strings_seed(17);
+	wy::hash<std::list<std::string>> h_string_list_seed(17);
+	ASSERT_EQ(h_strings_seed(strings), salted);
+	ASSERT_EQ(h_string_list_seed(string_list), salted);
+
+	// Aggregates with padding are hashed by their fields, never reading the padding
+	std::vector<padded_key> padded(2), padded_other(2);
+	memset(padded.data(), 0x00, sizeof(padded_key) * padded.size());
+	memset(padded_other.data(), 0xff, sizeof(padded_key) * padded_other.size());
+	for (size_t i = 0; i < padded.size(); i++)
+	{
+		padded[i].kind = padded_other[i].kind = 1;
+		padded[i].id = padded_other[i].id = i;
+		padded[i].shard = padded_other[i].shard = 2;
+	}
+	wy::hash<std::vector<padded_key>> h_padded(17);
+	ASSERT_EQ(h_padded(padded), h_padded(padded_other));
+	uint64_t padded_expected = mixer.combine(mixer.combine(mixer.combine(mixer.secret[0], wy::aggregate_hash<padded_key>(17)(padded[0])), wy::aggregate_hash<padded_key>(17)(padded[1])), 2);
+	ASSERT_EQ(h_padded(padded), padded_expected);
+
+	std::map<std::string, int> map = { { "a", 1 }, { "b", 2 } };
+	wy::hash<std::map<std::string, int>> h_map;
+	ASSERT_EQ(h_map(map), h_map(std::map<std::string, int>(map)));
+
+	// Floating point elements are combined by value: equal ranges hash the same
+	std::array<double, 2> zeros = { 0.0, 1.0 }, negative_zeros = { -0.0, 1.0 };
+	ASSERT_TRUE(zeros == negative_zeros);
+	wy::hash<std::array<double, 2>> h_doubles;
+	ASSERT_EQ(h_doubles(zeros), h_doubles(negative_zeros));
+	std::vector<double> doubles = { 0.5, -0.0, 2.0 };
+	std::deque<double> doubles_deque = { 0.5, 0.0, 2.0 };
+	wy::hash<std::vector<double>> h_double_vector;
+	wy::hash<std::deque<double>> h_double_deque;
+	ASSERT_EQ(h_double_vector(doubles), h_double_deque(doubles_deque));
+	doubles[2] = 3.0;
+	ASSERT_NE(h_double_vector(doubles), h_double_deque(doubles_deque));
+	std::vector<long double> long_doubles(3), long_doubles_other(3);
+	memset(long_doubles.data(), 0x00, sizeof(long double) * 3);
+	memset(long_doubles_other.data(), 0xff, sizeof(long double) * 3);
+	for (size_t i = 0; i < 3; i++) long_doubles[i] = long_doubles_other[i] = i * 0.25L;
+	wy::hash<std::vector<long double>> h_long_doubles;
+	ASSERT_EQ(h_long_doubles(long_doubles), h_long_doubles(long_doubles_other));
+
+	// std::array of bytes: the same as the other contiguous ranges over the bytes, on all sizes
+	std::array<uint8_t, 8> bytes8 = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	std::array<uint8_t, 16> bytes16 = {};
+	std::array<uint32_t, 5> words5 = { 1, 2, 3, 4, 5 };
+	wy::hash<std::array<uint8_t, 8>> h_bytes8;
+	wy::hash<std::array<uint8_t, 16>> h_bytes16;
+	wy::hash<std::array<uint32_t, 5>> h_words5;
+	wy::hash<std::span<const uint8_t>> h_byte_span;
+	wy::hash<std::vector<uint8_t>> h_byte_vector;
+	ASSERT_EQ(h_bytes8(bytes8), h_byte_span(std::span<const uint8_t>(bytes8)));
+	ASSERT_EQ(h_bytes8(bytes8), h_byte_vector(std::vector<uint8_t>(bytes8.begin(), bytes8.end())));
+	ASSERT_EQ(h_bytes16(bytes16), h.wyhash(bytes16.data(), bytes16.size()));
+	ASSERT_EQ(h_words5(words5), h.wyhash(reinterpret_cast<const uint8_t*>(words5.data()), sizeof(words5)));
+}
+
+TEST(wyhash, Hash128)
+{
+	wy::internal::hash_imp h, h_seed(31);
+	wy::hash128 h128, h128_seed(31);
+	uint8_t data[300];
+	for (size_t i = 0; i < sizeof(data); i++)
+		data[i] = static_cast<uint8_t>(i * 97 + 1);
+
+	// The low half is wyhash
+	for (size_t len = 0; len <= sizeof(data); len++)
+	{
+		ASSERT_EQ(h128(data, len).low, h.wyhash(data, len));
+		ASSERT_EQ(h128_seed(data, len).low, h_seed.wyhash(data, len));
+		ASSERT_NE(h128(data, len).high, h128(data, len).low);
+	}
+	ASSERT_EQ(h128(std::string_view("some string")), h128(reinterpret_cast<const uint8_t*>("some string"), 11));
+
+	// Avalanche of the high half: flipping an input bit flips about half of the output bits
+	for (size_t len : { 8, 16, 40, 64, 200 })
+	{
+		uint64_t reference = h128(data, len).high;
+		double flips = 0;
+		for (size_t bit = 0; bit < len * 8; bit++)
+		{
+			data[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+			flips += static_cast<double>(std::popcount(h128(data, len).high ^ reference));
+			data[bit / 8] ^= static_cast<uint8_t>(1 << (bit % 8));
+		}
+		ASSERT_NEAR(flips / (len * 8), 32, 1.5);
+	}
+
+	// The high half alone has no collisions on sequential keys
+	std::vector<uint64_t> highs;
+	for (uint64_t i = 0; i < 1000000; i++)
+		highs.push_back(h128(reinterpret_cast<const uint8_t*>(&i), sizeof(i)).high);
+	std::sort(highs.begin(), highs.end());
+	ASSERT_EQ(std::unique(highs.begin(), highs.end()), highs.end());
+}
@@ -0,0 +1,84 @@
+/////////////////////////////////////////////////////////////////////////////////
+// This file is a C++ wrapper around wyhash: 
+// https://github.com/wangyi-fudan/wyhash
+// 
+// Copyright (c) 2022 by Alain Espinosa.
+/////////////////////////////////////////////////////////////////////////////////
+
+// Tests of the statistics of wy::hash_stats: its own executable, as all the translation units of a program must
+// see the same WY_INSTRUMENT value. Also the light configuration: no file hashing and WY_THREADS 0
+#define WY_INSTRUMENT 1
+#include <wy.hpp>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <algorithm>
+
+TEST(hash_stats, Counters)
+{
+	wy::flat_map<std::string, int, wy::hash_stats<wy::hash<std::string>>> m;
+	const wy::hash_counters* stats = m.hash_function().stats();
+	ASSERT_NE(stats, nullptr);
+	m.reserve(10'000);// Each rehash calls the hasher again
+	for (int i = 0; i < 10'000; i++)
+		m[std::to_string(i)] = i;
+	ASSERT_EQ(m.hash_function().stats(), stats);// Shared by the copies
+	ASSERT_EQ(stats->num_calls(), 10'000u);
+	ASSERT_TRUE(m.contains(std::string_view("123")));// Transparent as wy::hash<std::string>
+	ASSERT_EQ(stats->num_calls(), 10'001u);
+
+	// Lengths 1 to 4 bytes
+	std::array<uint64_t, wy::hash_counters::num_length_buckets> lengths = stats->key_length_histogram();
+	ASSERT_EQ(lengths[1], 10u);// 1
+	ASSERT_EQ(lengths[2], 991u);// [2, 4)
+	ASSERT_EQ(lengths[3], 9'000u);// [4, 8)
+	ASSERT_EQ(std::accumulate(lengths.begin(), lengths.end(), uint64_t(0)), 10'001u);
+
+	// A good hash spreads the sample
+	ASSERT_EQ(stats->sample().size(), wy::hash_counters::sample_size);
+	std::vector<uint64_t> occupancy = stats->bucket_occupancy(1024);
+	ASSERT_EQ(std::accumulate(occupancy.begin(), occupancy.end(), uint64_t(0)), 1024u);
+	ASSERT_NEAR(stats->dispersion(1024), 1.0, 0.25);
+	ASSERT_NEAR(stats->dispersion(1000), 1.0, 0.25);
+	ASSERT_NE(stats->to_json(1024).find("\"calls\":10001,\"key_length_log2\":[0,10,991,9000],\"num_buckets\":1024,\"bucket_occupancy\":["), std::string::npos);
+}
+
+TEST(hash_stats, BadHash)
+{
+	// A bad hash clusters: only multiples of 1024
+	struct bad_hash { uint64_t operator()(uint64_t key) const noexcept { return (key % 64) << 10; } };
+	wy::hash_stats<bad_hash> bad;
+	for (uint64_t i = 0; i < 10'000; i++) bad(i);
+	ASSERT_EQ(bad.stats()->key_length_histogram()[4], 10'000u);// 8 bytes
+	ASSERT_GT(bad.stats()->dispersion(1024), 10.0);
+}
+
+TEST(light_config, HashTreeWithoutThreads)
+{
+	static_assert(WY_FILE_HASHING == 0 && WY_THREADS == 0);
+
+	wy::rand r(3);
+	std::vector<uint8_t> data = r.generate_stream(5000);
+
+	// Same digest as the threaded mode: the chunk hashes combined in order
+	wy::internal::hash_imp h;
+	uint64_t expected = h.wyhash(static_cast<uint64_t>(data.size()));
+	for (size_t offset = 0; offset < data.size(); offset += 1000)
+		expected = wy::internal::wyhash64(expected, h.wyhash(data.data() + offset, 1000));
+	ASSERT_EQ(wy::hash_tree(data.data(), data.size(), 1000, 4, h), expected);
+	ASSERT_EQ(wy::hash_tree(data.data(), data.size(), 1000, 0, h), expected);
+}
+
+TEST(light_config, ShuffleWithoutThreads)
+{
+	// The tiles run one after the other: still a permutation, repeatable for the same seed
+	std::vector<uint32_t> values(1 << 17);// 4 tiles
+	std::iota(values.begin(), values.end(), 0u);
+	std::vector<uint32_t> shuffled = values, again = values;
+	wy::rand r1(11), r2(11);
+	wy::shuffle(std::span<uint32_t>(shuffled), r1, 4);
+	wy::shuffle(std::span<uint32_t>(again), r2, 4);
+	ASSERT_EQ(shuffled, again);
+	ASSERT_NE(shuffled, values);
+	std::sort(shuffled.begin(), shuffled.end());
+	ASSERT_EQ(shuffled, values);
+}
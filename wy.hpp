@@ -16,12 +16,28 @@
 #include <cstring>
 #include <cstdint>
 #include <vector>
+#include <array>
 #include <random>
 #include <string>
 #include <version>
 #ifdef __cpp_lib_span
 	#include <span>
 #endif
+#include <atomic>
+#include <memory>
+#ifdef __cpp_lib_memory_resource
+	#include <memory_resource>
+#endif
+#include <utility>
+#include <tuple>
+#include <iterator>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <initializer_list>
+#include <optional>
+#include <algorithm>
+#include <cmath>
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // wyhash.h
@@ -39,10 +55,75 @@
 	#define WYHASH_32BIT_MUM 0  
 #endif
 
+#ifndef WY_INSTRUMENT
+	// 0: 'wy::hash_stats' only forwards to its hasher, at no cost
+	// 1: 'wy::hash_stats' records the calls, key lengths and a sample of the hashes
+	// The same value on all the translation units of a program: hash_stats is different on each mode
+	#define WY_INSTRUMENT 0
+#endif
+
+#ifndef WY_FILE_HASHING
+	// 0: no file hashing, the header doesn't include <filesystem> and the OS headers (<windows.h> on Windows)
+	// 1: 'wy::hash_file' and 'wy::hash_file_tree' hash memory mapped files
+	#define WY_FILE_HASHING 0
+#endif
+
+#ifndef WY_THREADS
+	// 0: the modes taking 'num_threads' split their work the same but run it on the calling thread (same results for
+	//    the same 'num_threads', 0 is one thread)
+	// 1: they run on std::thread, and 'wy::concurrent_map' is available. The same value on all the translation units of a program
+	#define WY_THREADS 0
+#endif
+
 // includes
+#if WY_THREADS
+	#include <thread>
+	#include <mutex>
+	#include <shared_mutex>
+#endif
+#if WY_FILE_HASHING
+	#include <filesystem>
+	// Memory mapped files needed for 'hash_file(path)'
+	#ifdef _WIN32
+		#ifndef NOMINMAX
+			#define NOMINMAX
+			#define WY_UNDEF_NOMINMAX
+		#endif
+		#ifndef WIN32_LEAN_AND_MEAN
+			#define WIN32_LEAN_AND_MEAN
+			#define WY_UNDEF_WIN32_LEAN_AND_MEAN
+		#endif
+		#include <windows.h>
+		#ifdef WY_UNDEF_NOMINMAX
+			#undef NOMINMAX
+			#undef WY_UNDEF_NOMINMAX
+		#endif
+		#ifdef WY_UNDEF_WIN32_LEAN_AND_MEAN
+			#undef WIN32_LEAN_AND_MEAN
+			#undef WY_UNDEF_WIN32_LEAN_AND_MEAN
+		#endif
+	#else
+		#include <fcntl.h>
+		#include <sys/mman.h>
+		#include <sys/stat.h>
+		#include <unistd.h>
+	#endif
+#endif
 #if defined(_MSC_VER) && defined(_M_X64)
 	#include <intrin.h>
 	#pragma intrinsic(_umul128)
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+	#include <intrin.h>// __umulh
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+	#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define WY_HAS_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+	#include <arm_neon.h>
+	#define WY_HAS_NEON 1
 #endif
 
 // likely and unlikely macros
@@ -170,6 +251,340 @@ namespace wy::internal
 	// fast range integer random number generation on [0,k) credit to Daniel Lemire. May not work when WYHASH_32BIT_MUM=1. It can be combined with wyrand, wyhash64 or wyhash.
 	static forceinline uint64_t wy2u0k(uint64_t r, uint64_t k) noexcept { _wymum(&r, &k); return k; }
 #endif
+
+	// Hint the CPU to bring a cache line that will be used soon
+	static forceinline void _wyprefetch(const void* p) noexcept
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(p);
+#elif WY_HAS_SSE2
+		_mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+		(void)p;
+#endif
+	}
+
+	// High 64 bits of the 128bit product, not affected by WYHASH_CONDOM or WYHASH_32BIT_MUM. Reduce an uniform 'A' to [0,B)
+	static forceinline uint64_t _wymulhi(uint64_t A, uint64_t B) noexcept
+	{
+#if defined(__SIZEOF_INT128__)
+		return static_cast<uint64_t>((static_cast<__uint128_t>(A) * B) >> 64);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		return __umulh(A, B);
+#else
+		uint64_t ha = A >> 32, hb = B >> 32, la = (uint32_t)A, lb = (uint32_t)B;
+		uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+		uint64_t lo = t + (rm1 << 32); c += lo < t;
+		return rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+	}
+
+	// The number of bits set
+	static forceinline unsigned _wypopcount(uint64_t x) noexcept
+	{
+#if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__clang__)
+		return static_cast<unsigned>(__builtin_popcountll(x));
+#elif defined(_MSC_VER) && defined(_M_X64)
+		return static_cast<unsigned>(_mm_popcnt_u64(x));
+#else
+		x -= (x >> 1) & 0x5555555555555555;
+		x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
+		return static_cast<unsigned>((x * 0x0101010101010101) >> 56);
+#endif
+	}
+}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Multi-lane wyrand
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The vector kernels are compiled for AVX2 and AVX-512 even without -mavx2/-mavx512f and selected at runtime
+#if !WYHASH_32BIT_MUM && (defined(__x86_64__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define WY_HAS_DISPATCH 1
+	#if defined(__GNUC__) || defined(__clang__)
+		#define WY_TARGET_AVX2 __attribute__((target("avx2")))
+		#define WY_TARGET_AVX512 __attribute__((target("avx512f")))
+	#else
+		#define WY_TARGET_AVX2
+		#define WY_TARGET_AVX512
+	#endif
+#endif
+
+namespace wy
+{
+	/// <summary>
+	/// Implementations of the vector kernels. All of them produce exactly the same output.
+	/// </summary>
+	enum class cpu_path : uint8_t
+	{
+		scalar = 0,
+		avx2 = 1,
+		avx512 = 2
+	};
+
+	namespace internal
+	{
+		// Best path supported by the CPU (and the OS, that needs to save the vector registers)
+		inline cpu_path detect_cpu_path() noexcept
+		{
+#if WY_HAS_DISPATCH && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return cpu_path::scalar;
+			__cpuid(info, 1);
+			if (!((info[2] >> 27) & 1) || !((info[2] >> 28) & 1))// OSXSAVE and AVX
+				return cpu_path::scalar;
+			uint64_t xcr0 = _xgetbv(0);
+			__cpuidex(info, 7, 0);
+			if ((xcr0 & 0xe6) == 0xe6 && ((info[1] >> 16) & 1))// ZMM state and AVX512F
+				return cpu_path::avx512;
+			if ((xcr0 & 0x6) == 0x6 && ((info[1] >> 5) & 1))// YMM state and AVX2
+				return cpu_path::avx2;
+#elif WY_HAS_DISPATCH
+			__builtin_cpu_init();// May run before the constructors of the runtime
+			if (__builtin_cpu_supports("avx512f"))
+				return cpu_path::avx512;
+			if (__builtin_cpu_supports("avx2"))
+				return cpu_path::avx2;
+#endif
+			return cpu_path::scalar;
+		}
+		// The path used by the kernels, resolved once at startup. Zero initialized (scalar) before that
+		inline std::atomic<cpu_path> active_path{ detect_cpu_path() };
+
+		// The threads of the modes taking 'num_threads': the ones asked, 0 for all hardware threads (1 without 'WY_THREADS')
+		inline unsigned num_threads_to_use(unsigned num_threads) noexcept
+		{
+#if WY_THREADS
+			return num_threads ? num_threads : std::thread::hardware_concurrency();
+#else
+			return num_threads ? num_threads : 1;
+#endif
+		}
+	}
+
+	/// <summary>
+	/// The best implementation of the vector kernels supported by this CPU
+	/// </summary>
+	/// <returns>The detected path, always 'scalar' when the kernels are not compiled for this platform</returns>
+	inline cpu_path detected_cpu_path() noexcept
+	{
+		static const cpu_path path = internal::detect_cpu_path();
+		return path;
+	}
+	/// <summary>
+	/// The implementation of the vector kernels in use
+	/// </summary>
+	inline cpu_path active_cpu_path() noexcept
+	{
+		return internal::active_path.load(std::memory_order_relaxed);
+	}
+	/// <summary>
+	/// Force an implementation of the vector kernels, ex: to compare paths or to rule out a CPU issue.
+	/// Paths not supported by the CPU are downgraded to the best supported.
+	/// </summary>
+	/// <param name="path">The path to use</param>
+	/// <returns>The path in use from now on</returns>
+	inline cpu_path force_cpu_path(cpu_path path) noexcept
+	{
+		cpu_path best = detected_cpu_path();
+		if (path > best)
+			path = best;
+		internal::active_path.store(path, std::memory_order_relaxed);
+		return path;
+	}
+	/// <summary>
+	/// The name of a path, for logs and benchmarks
+	/// </summary>
+	inline const char* cpu_path_name(cpu_path path) noexcept
+	{
+		switch (path)
+		{
+		case cpu_path::avx2: return "avx2";
+		case cpu_path::avx512: return "avx512";
+		default: return "scalar";
+		}
+	}
+}
+
+namespace wy::internal
+{
+	// As the wyrand state is a Weyl sequence, lane j of LANES starting at 'seed + (j + 1) * 0xa0761d6478bd642f' and stepping by
+	// 'LANES * 0xa0761d6478bd642f' generates exactly the values j, j + LANES, j + 2 * LANES, ... of the serial sequence.
+	// So the interleaved lanes produce the same bytes as calling wyrand serially.
+#if WY_HAS_DISPATCH
+	// 8 lanes 64x64->128 multiply and xor mix, composed from 32x32->64 multiplies.
+	// The zero-masked forms with all lanes set compile to the plain instructions: GCC implements the unmasked ones
+	// merging into _mm512_undefined_epi32(), which gives false -Wmaybe-uninitialized warnings once inlined
+	WY_TARGET_AVX512 static forceinline __m512i _wymix_x8(__m512i A, __m512i B) noexcept
+	{
+		const __m512i mask32 = _mm512_set1_epi64(0xffffffff);
+		const __mmask8 all = 0xff;
+		__m512i ha = _mm512_maskz_srli_epi64(all, A, 32), hb = _mm512_maskz_srli_epi64(all, B, 32);
+		__m512i rl = _mm512_maskz_mul_epu32(all, A, B), rm0 = _mm512_maskz_mul_epu32(all, ha, B), rm1 = _mm512_maskz_mul_epu32(all, A, hb), rh = _mm512_maskz_mul_epu32(all, ha, hb);
+		__m512i mid = _mm512_add_epi64(_mm512_add_epi64(_mm512_maskz_srli_epi64(all, rl, 32), _mm512_and_si512(rm0, mask32)), _mm512_and_si512(rm1, mask32));
+		__m512i lo = _mm512_or_si512(_mm512_and_si512(rl, mask32), _mm512_maskz_slli_epi64(all, mid, 32));
+		__m512i hi = _mm512_add_epi64(_mm512_add_epi64(rh, _mm512_maskz_srli_epi64(all, rm0, 32)), _mm512_add_epi64(_mm512_maskz_srli_epi64(all, rm1, 32), _mm512_maskz_srli_epi64(all, mid, 32)));
+	#if WYHASH_CONDOM > 1
+		return _mm512_xor_si512(_mm512_xor_si512(lo, A), _mm512_xor_si512(hi, B));
+	#else
+		return _mm512_xor_si512(lo, hi);
+	#endif
+	}
+	// 4 lanes 64x64->128 multiply and xor mix, composed from 32x32->64 multiplies
+	WY_TARGET_AVX2 static forceinline __m256i _wymix_x4(__m256i A, __m256i B) noexcept
+	{
+		const __m256i mask32 = _mm256_set1_epi64x(0xffffffff);
+		__m256i ha = _mm256_srli_epi64(A, 32), hb = _mm256_srli_epi64(B, 32);
+		__m256i rl = _mm256_mul_epu32(A, B), rm0 = _mm256_mul_epu32(ha, B), rm1 = _mm256_mul_epu32(A, hb), rh = _mm256_mul_epu32(ha, hb);
+		__m256i mid = _mm256_add_epi64(_mm256_add_epi64(_mm256_srli_epi64(rl, 32), _mm256_and_si256(rm0, mask32)), _mm256_and_si256(rm1, mask32));
+		__m256i lo = _mm256_or_si256(_mm256_and_si256(rl, mask32), _mm256_slli_epi64(mid, 32));
+		__m256i hi = _mm256_add_epi64(_mm256_add_epi64(rh, _mm256_srli_epi64(rm0, 32)), _mm256_add_epi64(_mm256_srli_epi64(rm1, 32), _mm256_srli_epi64(mid, 32)));
+	#if WYHASH_CONDOM > 1
+		return _mm256_xor_si256(_mm256_xor_si256(lo, A), _mm256_xor_si256(hi, B));
+	#else
+		return _mm256_xor_si256(lo, hi);
+	#endif
+	}
+
+	// Vector part of 'wyrand_stream': returns the number of 64-bit numbers generated, a multiple of the lanes
+	WY_TARGET_AVX512 static inline size_t wyrand_stream_avx512(uint64_t* seed, uint8_t* out, size_t num_words) noexcept
+	{
+		uint64_t s = *seed;
+		__m512i state = _mm512_set_epi64(s + 8 * 0xa0761d6478bd642full, s + 7 * 0xa0761d6478bd642full, s + 6 * 0xa0761d6478bd642full, s + 5 * 0xa0761d6478bd642full,
+			s + 4 * 0xa0761d6478bd642full, s + 3 * 0xa0761d6478bd642full, s + 2 * 0xa0761d6478bd642full, s + 0xa0761d6478bd642full);
+		const __m512i step = _mm512_set1_epi64(8 * 0xa0761d6478bd642full), xor_const = _mm512_set1_epi64(0xe7037ed1a0b428dbull);
+		size_t i = 0;
+		for (; i + 8 <= num_words; i += 8) {
+			_mm512_storeu_si512(out + i * sizeof(uint64_t), _wymix_x8(state, _mm512_xor_si512(state, xor_const)));
+			state = _mm512_add_epi64(state, step);
+		}
+		*seed += i * 0xa0761d6478bd642full;
+		return i;
+	}
+	WY_TARGET_AVX2 static inline size_t wyrand_stream_avx2(uint64_t* seed, uint8_t* out, size_t num_words) noexcept
+	{
+		uint64_t s = *seed;
+		__m256i state = _mm256_set_epi64x(s + 4 * 0xa0761d6478bd642full, s + 3 * 0xa0761d6478bd642full, s + 2 * 0xa0761d6478bd642full, s + 0xa0761d6478bd642full);
+		const __m256i step = _mm256_set1_epi64x(4 * 0xa0761d6478bd642full), xor_const = _mm256_set1_epi64x(0xe7037ed1a0b428dbull);
+		size_t i = 0;
+		for (; i + 4 <= num_words; i += 4) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * sizeof(uint64_t)), _wymix_x4(state, _mm256_xor_si256(state, xor_const)));
+			state = _mm256_add_epi64(state, step);
+		}
+		*seed += i * 0xa0761d6478bd642full;
+		return i;
+	}
+#endif
+
+	/// <summary>
+	/// Generate 64-bit random numbers with up to LANES interleaved wyrand lanes. Same result as calling wyrand 'num_words' times.
+	/// </summary>
+	/// <typeparam name="LANES">The maximum number of lanes. They map to AVX2 (4) or AVX-512 (8) when 'active_cpu_path()' allows it</typeparam>
+	/// <param name="seed">in/out: The wyrand state</param>
+	/// <param name="out">out: The random bytes, in little endian order</param>
+	/// <param name="num_words">The number of 64-bit random numbers to generate</param>
+	template<size_t LANES> static forceinline void wyrand_stream(uint64_t* seed, uint8_t* out, size_t num_words) noexcept
+	{
+		static_assert(LANES == 1 || LANES == 4 || LANES == 8, "Supported lanes are 1, 4 and 8");
+		size_t i = 0;
+
+#if WY_HAS_DISPATCH
+		if constexpr (LANES > 1) {
+			cpu_path path = active_path.load(std::memory_order_relaxed);
+			if (LANES == 8 && path == cpu_path::avx512 && num_words >= 8)
+				i = wyrand_stream_avx512(seed, out, num_words);
+			else if (path != cpu_path::scalar && num_words >= 4)
+				i = wyrand_stream_avx2(seed, out, num_words);
+		}
+#endif
+
+		// Scalar part: vector kernels are not available or final part
+		uint64_t s = *seed;// local copy: the output bytes may alias the state
+		for (uint8_t* end = out + num_words * sizeof(uint64_t), *ptr = out + i * sizeof(uint64_t); ptr < end; ptr += sizeof(uint64_t))
+		{
+#if WYHASH_LITTLE_ENDIAN
+			uint64_t val = wyrand(&s);
+#else
+			uint64_t val = byteswap64(wyrand(&s));
+#endif
+			memcpy(ptr, &val, sizeof(uint64_t));
+		}
+		*seed = s;
+	}
+
+	/// <summary>
+	/// Fill a buffer with random bytes. The last partial 64-bit number is truncated.
+	/// </summary>
+	/// <typeparam name="LANES">The number of interleaved lanes</typeparam>
+	/// <param name="seed">in/out: The wyrand state</param>
+	/// <param name="data">out: The random bytes</param>
+	/// <param name="len">The number of bytes to generate</param>
+	template<size_t LANES> static forceinline void wyrand_fill(uint64_t* seed, uint8_t* data, size_t len) noexcept
+	{
+		wyrand_stream<LANES>(seed, data, len / sizeof(uint64_t));
+
+		// Final part
+		size_t rest = len % sizeof(uint64_t);
+		if (rest)
+		{
+			uint8_t last[sizeof(uint64_t)];
+			wyrand_stream<1>(seed, last, 1);
+			memcpy(data + len - rest, last, rest);
+		}
+	}
+
+	// Ziggurat of 256 layers of the same area (Marsaglia & Tsang). Layer i covers [0, x[i]) and its rectangle [0, x[i + 1])
+	// is under the density, where a sample is accepted without evaluating the density. x[0] is the width of the base layer
+	// of area 'V' that includes the tail after x[1] = R.
+	struct ziggurat_table
+	{
+		double x[257];
+		double f[257];// The (unnormalized) density at x
+	};
+	template<class PDF, class INVERSE_PDF> static ziggurat_table make_ziggurat(double R, double V, PDF pdf, INVERSE_PDF inverse_pdf) noexcept
+	{
+		ziggurat_table table;
+		table.x[0] = V / pdf(R);
+		table.x[1] = R;
+		for (size_t i = 2; i < 256; i++)
+		{
+			double y = pdf(table.x[i - 1]) + V / table.x[i - 1];
+			table.x[i] = y < 1 ? inverse_pdf(y) : 0;
+		}
+		table.x[256] = 0;
+		for (size_t i = 0; i < 257; i++)
+			table.f[i] = pdf(table.x[i]);
+		return table;
+	}
+	inline const ziggurat_table& ziggurat_normal() noexcept
+	{
+		static const ziggurat_table table = make_ziggurat(3.6541528853610088, 0.00492867323399,
+			[](double x) { return std::exp(-0.5 * x * x); }, [](double y) { return std::sqrt(-2.0 * std::log(y)); });
+		return table;
+	}
+	inline const ziggurat_table& ziggurat_exponential() noexcept
+	{
+		static const ziggurat_table table = make_ziggurat(7.69711747013104972, 0.0039496598225815571993,
+			[](double x) { return std::exp(-x); }, [](double y) { return -std::log(y); });
+		return table;
+	}
+
+	/// <summary>
+	/// log(k!) for the Poisson rejection: a table for k < 10, else the Stirling series (truncation error under 1e-10).
+	/// Not std::lgamma, which writes the global 'signgam' on POSIX: a data race between threads sampling.
+	/// </summary>
+	inline double log_factorial(double k) noexcept
+	{
+		static constexpr double table[10] = { 0.0, 0.0, 0.693147180559945, 1.7917594692280554, 3.178053830347945, 4.787491742782047, 6.579251212010102, 8.525161361065415, 10.604602902745249, 12.801827480081467 };
+		if (k < 10)
+			return table[static_cast<size_t>(k)];
+		double inv_k = 1 / k, inv_k2 = inv_k * inv_k;
+		return (k + 0.5) * std::log(k) - k + 0.91893853320467274178 + inv_k * (1.0 / 12 - inv_k2 * (1.0 / 360 - inv_k2 * (1.0 / 1260)));
+	}
 }
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -224,6 +639,49 @@ namespace wy {
 		rand(uint64_t seed) noexcept : state(seed)
 		{}
 
+		/// <summary>
+		/// Advance the generator in O(1). Same as calling operator() 'n' times.
+		/// </summary>
+		/// <param name="n">The number of values to skip</param>
+		forceinline void discard(uint64_t n) noexcept
+		{
+			state += n * 0xa0761d6478bd642full;// The state is a Weyl sequence
+		}
+
+		static constexpr uint64_t substream_length = 1ull << 40;// The number of values of each substream
+		static constexpr uint64_t max_substreams = 1ull << 24;// The number of non-overlapping substreams
+
+		/// <summary>
+		/// Get a generator for a non-overlapping slice of this generator sequence.
+		/// Substream 'index' starts 'index * substream_length' values after the current state,
+		/// so work split by substream index is reproducible no matter how many threads run.
+		/// </summary>
+		/// <param name="index">The index of the substream, lower than 'max_substreams'</param>
+		/// <returns>The generator of the substream</returns>
+		forceinline rand substream(uint64_t index) const noexcept
+		{
+			assert(index < max_substreams);
+
+			rand result(state);
+			result.discard(index * substream_length);
+			return result;
+		}
+
+		/// <summary>
+		/// Split this generator sequence in non-overlapping substreams, one by worker.
+		/// The generator 'i' is the same as 'substream(i)'.
+		/// </summary>
+		/// <param name="count">The number of generators</param>
+		/// <returns>The generators of the substreams 0, 1, ... count-1</returns>
+		std::vector<rand> split(size_t count) const noexcept
+		{
+			std::vector<rand> result;
+			result.reserve(count);
+			for (size_t i = 0; i < count; i++)
+				result.push_back(substream(i));
+			return result;
+		}
+
 		/// <summary>
 		/// Generate a random value from the uniform distribution [0,1)
 		/// </summary>
@@ -286,43 +744,191 @@ namespace wy {
 			return gaussian_dist() * std + mean;
 		}
 
+		/// <summary>
+		/// Generate a random value from the uniform distribution [0, max_value) without bias (Lemire's method).
+		/// Slightly slower than 'uniform_dist(max_value)' that is biased by up to 'max_value / 2^64'.
+		/// </summary>
+		/// <param name="max_value">The maximum value (exclusive), greater than 0</param>
+		/// <returns>The random value</returns>
+		forceinline uint64_t uniform_dist_unbiased(uint64_t max_value) noexcept
+		{
+			assert(max_value > 0);
+
+			uint64_t r = operator()();
+			uint64_t low = r * max_value;
+			if (_unlikely_(low < max_value))
+			{
+				// Reject the 2^64 % max_value products that make the low values more probable
+				uint64_t threshold = (0 - max_value) % max_value;
+				while (low < threshold)
+				{
+					r = operator()();
+					low = r * max_value;
+				}
+			}
+			return internal::_wymulhi(r, max_value);
+		}
+
+		/// <summary>
+		/// Generate a random value from the EXACT normal distribution with mean=0 and std=1 (ziggurat method).
+		/// Almost always one random number by value, unlike the approximate 'gaussian_dist()' that is limited to [-3, 3].
+		/// </summary>
+		/// <returns>The random value</returns>
+		forceinline double normal_dist() noexcept
+		{
+			const internal::ziggurat_table& table = internal::ziggurat_normal();
+			for (;;)
+			{
+				uint64_t r = operator()();
+				size_t i = r & 0xff;// The layer
+				double x = ((r >> 11) * (2.0 / (1ull << 53)) - 1.0) * table.x[i];// Signed position on the layer
+				if (std::fabs(x) < table.x[i + 1])
+					return x;
+
+				if (i == 0)
+				{
+					// Tail after R (Marsaglia)
+					double tx, ty;
+					do {
+						tx = std::log(open_uniform()) / table.x[1];
+						ty = std::log(open_uniform());
+					} while (-2.0 * ty < tx * tx);
+					return x < 0 ? tx - table.x[1] : table.x[1] - tx;
+				}
+				if (table.f[i + 1] + (table.f[i] - table.f[i + 1]) * uniform_dist() < std::exp(-0.5 * x * x))
+					return x;
+			}
+		}
+		/// <summary>
+		/// Generate a random value from the EXACT normal distribution with mean and std
+		/// </summary>
+		/// <param name="mean">The normal mean</param>
+		/// <param name="std">The normal Standard Deviation</param>
+		/// <returns>The random value</returns>
+		forceinline double normal_dist(double mean, double std) noexcept
+		{
+			assert(std > 0);
+
+			return normal_dist() * std + mean;
+		}
+
+		/// <summary>
+		/// Generate a random value from the exponential distribution with rate=1 (ziggurat method)
+		/// </summary>
+		/// <returns>The random value</returns>
+		forceinline double exponential_dist() noexcept
+		{
+			const internal::ziggurat_table& table = internal::ziggurat_exponential();
+			for (;;)
+			{
+				uint64_t r = operator()();
+				size_t i = r & 0xff;// The layer
+				double x = (r >> 11) * (1.0 / (1ull << 53)) * table.x[i];
+				if (x < table.x[i + 1])
+					return x;
+
+				if (i == 0)
+					return table.x[1] - std::log(open_uniform());// The tail is memoryless
+				if (table.f[i + 1] + (table.f[i] - table.f[i + 1]) * uniform_dist() < std::exp(-x))
+					return x;
+			}
+		}
+		/// <summary>
+		/// Generate a random value from the exponential distribution
+		/// </summary>
+		/// <param name="rate">The rate (lambda), the inverse of the mean</param>
+		/// <returns>The random value</returns>
+		forceinline double exponential_dist(double rate) noexcept
+		{
+			assert(rate > 0);
+
+			return exponential_dist() / rate;
+		}
+
+		/// <summary>
+		/// Generate a random value from the Poisson distribution: inversion for small means (one random number)
+		/// and transformed rejection with squeeze (PTRS, Hormann) for means of 10 or more.
+		/// </summary>
+		/// <param name="mean">The mean (lambda)</param>
+		/// <returns>The random value</returns>
+		uint64_t poisson_dist(double mean) noexcept
+		{
+			assert(mean >= 0);
+
+			if (mean < 10)
+			{
+				double u = uniform_dist(), p = std::exp(-mean), cdf = p;
+				uint64_t k = 0;
+				while (u > cdf)
+				{
+					k++;
+					p *= mean / k;
+					double next = cdf + p;
+					if (next == cdf)// Rounding: the cdf doesn't reach 1
+						break;
+					cdf = next;
+				}
+				return k;
+			}
+
+			double slam = std::sqrt(mean), loglam = std::log(mean);
+			double b = 0.931 + 2.53 * slam, a = -0.059 + 0.02483 * b;
+			double invalpha = 1.1239 + 1.1328 / (b - 3.4), vr = 0.9277 - 3.6224 / (b - 2);
+			for (;;)
+			{
+				double U = uniform_dist() - 0.5, V = uniform_dist();
+				double us = 0.5 - std::fabs(U);
+				double k = std::floor((2 * a / us + b) * U + mean + 0.43);
+				if (us >= 0.07 && V <= vr)
+					return static_cast<uint64_t>(k);
+				if (k < 0 || (us < 0.013 && V > us))
+					continue;
+				if (std::log(V) + std::log(invalpha) - std::log(a / (us * us) + b) <= -mean + k * loglam - internal::log_factorial(k))
+					return static_cast<uint64_t>(k);
+			}
+		}
+
 		/// <summary>
 		/// Generate a random stream of bytes.
 		/// </summary>
 		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
+		/// <typeparam name="ALLOCATOR">The allocator of the vector</typeparam>
 		/// <param name="size">The number of elements of the vector to generate</param>
+		/// <param name="alloc">The allocator to use, ex: a 'std::pmr::polymorphic_allocator' over an arena</param>
 		/// <returns>A vector of random elements</returns>
-		template<class T=uint8_t> forceinline std::vector<T> generate_stream(size_t size) noexcept
+		template<class T=uint8_t, class ALLOCATOR = std::allocator<T>, class = typename ALLOCATOR::value_type> forceinline std::vector<T, ALLOCATOR> generate_stream(size_t size, const ALLOCATOR& alloc = ALLOCATOR()) noexcept
 		{
-			std::vector<T> result;
+			std::vector<T, ALLOCATOR> result(alloc);
 			generate_stream<T>(result, size);
 			return result;
 		}
+#ifdef __cpp_lib_memory_resource
+		/// <summary>
+		/// Generate a random stream of bytes on a memory resource.
+		/// </summary>
+		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
+		/// <param name="size">The number of elements of the vector to generate</param>
+		/// <param name="resource">The memory resource of the vector, ex: a 'std::pmr::monotonic_buffer_resource'</param>
+		/// <returns>A vector of random elements</returns>
+		template<class T=uint8_t> forceinline std::pmr::vector<T> generate_stream(size_t size, std::pmr::memory_resource* resource) noexcept
+		{
+			return generate_stream<T>(size, std::pmr::polymorphic_allocator<T>(resource));
+		}
+#endif
 
 		/// <summary>
 		/// Generate a random stream of bytes.
 		/// </summary>
 		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
-		/// <param name="vec">out: A vector of random elements</param>
+		/// <param name="vec">out: A vector of random elements, keeps its allocator</param>
 		/// <param name="size">The number of elements of the vector to generate</param>
-		template<class T=uint8_t> void generate_stream(std::vector<T>& vec, size_t size) noexcept
+		template<class T=uint8_t, class ALLOCATOR> void generate_stream(std::vector<T, ALLOCATOR>& vec, size_t size) noexcept
 		{
 			size_t sizeOf64 = (size * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t); // The number of 64-bits numbers to generate
 
-			// Create the memory on the vector
+			// Create the memory on the vector: always whole 64-bits numbers
 			vec.resize((sizeOf64 * sizeof(uint64_t) + sizeof(T) - 1) / sizeof(T));
-			uint8_t* dataPtr = reinterpret_cast<uint8_t*>(vec.data());
-
-			// Generate random values
-			for (size_t i = 0; i < sizeOf64; i++)
-			{
-#if WYHASH_LITTLE_ENDIAN
-				uint64_t val = operator()();
-#else
-				uint64_t val = byteswap64(operator()());
-#endif
-				memcpy(dataPtr + i * sizeof(uint64_t), &val, sizeof(uint64_t));
-			}
+			internal::wyrand_stream<8>(&state, reinterpret_cast<uint8_t*>(vec.data()), sizeOf64);
 
 			// Final size
 			vec.resize(size);
@@ -335,287 +941,4115 @@ namespace wy {
 		/// <param name="data">out: A span of random elements</param>
 		template<class T = uint8_t> void generate_stream(std::span<T> data) noexcept
 		{
-			uint64_t* dataPtr = reinterpret_cast<uint64_t*>(data.data());
-
-			// Generate random values
-			for (size_t i = 0; i < data.size() * sizeof(T) / sizeof(uint64_t); i++, dataPtr++)
-			{
-#if WYHASH_LITTLE_ENDIAN
-				uint64_t val = operator()();
-#else
-				uint64_t val = byteswap64(operator()());
-#endif
-				memcpy(dataPtr, &val, sizeof(uint64_t));
-			}
-			// Final part
-			size_t rest = data.size() * sizeof(T) % sizeof(uint64_t);
-			if (rest)
-			{
-#if WYHASH_LITTLE_ENDIAN
-				uint64_t val = operator()();
-#else
-				uint64_t val = byteswap64(operator()());
-#endif
-				memcpy(dataPtr, &val, rest);
-			}
+			internal::wyrand_fill<8>(&state, reinterpret_cast<uint8_t*>(data.data()), data.size_bytes());
 		}
-#endif
-	};
 
-	/// <summary>
-	/// Internal implementations
-	/// </summary>
-	namespace internal {
 		/// <summary>
-		/// Hash base class
+		/// Fill a span with random values from the uniform distribution [0,1).
+		/// Same values as calling 'uniform_dist()' for each element, but faster.
 		/// </summary>
-		struct hash_imp
+		/// <param name="data">out: The random values</param>
+		void fill_uniform(std::span<double> data) noexcept
 		{
-			uint64_t secret[4];// salted: We use dynamic secret to avoid intended attacks.
+			fill_converted(data, [](uint64_t r) noexcept {
+				// Same as '(r >> 12) * _wynorm': exact conversion that vectorizes without 64-bit integer to double instructions
+				uint64_t bits = (r >> 12) | 0x3ff0000000000000ull;// 1.0 + (r >> 12) / 2^52
+				double val;
+				memcpy(&val, &bits, sizeof(val));
+				return val - 1.0;
+			});
+		}
+		/// <summary>
+		/// Fill a span with random values from the uniform distribution [min_value, max_value).
+		/// Same values as calling 'uniform_dist(min_value, max_value)' for each element, but faster.
+		/// </summary>
+		/// <param name="data">out: The random values</param>
+		/// <param name="min_value">The minimum value (inclusive)</param>
+		/// <param name="max_value">The maximum value (exclusive)</param>
+		void fill_uniform(std::span<double> data, double min_value, double max_value) noexcept
+		{
+			assert(max_value > min_value);
+
+			fill_uniform(data);
+			double range = max_value - min_value;
+			for (double& val : data)
+				val = val * range + min_value;
+		}
+#if !WYHASH_32BIT_MUM
+		/// <summary>
+		/// Fill a span with random values from the uniform distribution [0, max_value).
+		/// Same values as calling 'uniform_dist(max_value)' for each element, but faster.
+		/// </summary>
+		/// <param name="data">out: The random values</param>
+		/// <param name="max_value">The maximum value (exclusive)</param>
+		void fill_uniform(std::span<uint64_t> data, uint64_t max_value) noexcept
+		{
+			fill_converted(data, [max_value](uint64_t r) noexcept { return internal::wy2u0k(r, max_value); });
+		}
+#endif
+		/// <summary>
+		/// Fill a span with random values from APPROXIMATE Gaussian distribution with mean=0 and std=1.
+		/// Same values as calling 'gaussian_dist()' for each element, but faster.
+		/// </summary>
+		/// <param name="data">out: The random values</param>
+		void fill_gaussian(std::span<double> data) noexcept
+		{
+			fill_converted(data, [](uint64_t r) noexcept {
+				// Same as 'gaussian_dist()': the sum is lower than 2^23, so it is converted exactly with the 2^52 trick
+				uint64_t bits = ((r & 0x1fffff) + ((r >> 21) & 0x1fffff) + ((r >> 42) & 0x1fffff)) | 0x4330000000000000ull;// 2^52 + sum
+				double val;
+				memcpy(&val, &bits, sizeof(val));
+				constexpr double _wynorm = 1.0 / (1ull << 20);
+				return (val - 4503599627370496.0) * _wynorm - 3.0;
+			});
+		}
+		/// <summary>
+		/// Fill a span with random values from APPROXIMATE Gaussian distribution with mean and std.
+		/// Same values as calling 'gaussian_dist(mean, std)' for each element, but faster.
+		/// </summary>
+		/// <param name="data">out: The random values</param>
+		/// <param name="mean">The Gaussian mean</param>
+		/// <param name="std">The Gaussian Standard Deviation</param>
+		void fill_gaussian(std::span<double> data, double mean, double std) noexcept
+		{
+			assert(std > 0);
+
+			fill_gaussian(data);
+			for (double& val : data)
+				val = val * std + mean;
+		}
+
+	private:
+		/// <summary>
+		/// Fill a span with random words converted to values, by blocks that fit on L1 cache.
+		/// The words are generated with 'generate_stream' and then converted in a separate vectorizable pass.
+		/// </summary>
+		template<class T, class CONVERT> forceinline void fill_converted(std::span<T> data, CONVERT convert) noexcept
+		{
+			uint64_t block[512];
+
+			for (size_t pos = 0; pos < data.size(); pos += std::size(block))
+			{
+				size_t block_size = data.size() - pos < std::size(block) ? data.size() - pos : std::size(block);
+				generate_stream(std::span<uint64_t>(block, block_size));
+				for (size_t i = 0; i < block_size; i++)
+				{
+#if WYHASH_LITTLE_ENDIAN
+					data[pos + i] = convert(block[i]);
+#else
+					data[pos + i] = convert(byteswap64(block[i]));
+#endif
+				}
+			}
+		}
+#endif
+
+	private:
+		// A random value from the uniform distribution (0,1), never zero: for logarithms
+		forceinline double open_uniform() noexcept
+		{
+			return ((operator()() >> 11) + 0.5) * (1.0 / (1ull << 53));
+		}
+	};
+
+	/// <summary>
+	/// Pseudo random numbers generator using LANES interleaved WYRAND states derived from one seed.
+	/// Generates exactly the same sequence as 'wy::rand' with the same seed, the lanes only change
+	/// how the bulk 'generate_stream' is computed: with AVX2 (4) or AVX-512 (8) vectors when 'wy::active_cpu_path()' allows it.
+	/// </summary>
+	/// <typeparam name="LANES">The number of lanes: 4 or 8</typeparam>
+	template<size_t LANES> struct rand_lanes : public rand
+	{
+		using rand::rand;// Inherit constructors
+
+		/// <summary>
+		/// Generate a random stream of bytes.
+		/// </summary>
+		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
+		/// <typeparam name="ALLOCATOR">The allocator of the vector</typeparam>
+		/// <param name="size">The number of elements of the vector to generate</param>
+		/// <param name="alloc">The allocator to use, ex: a 'std::pmr::polymorphic_allocator' over an arena</param>
+		/// <returns>A vector of random elements</returns>
+		template<class T = uint8_t, class ALLOCATOR = std::allocator<T>, class = typename ALLOCATOR::value_type> forceinline std::vector<T, ALLOCATOR> generate_stream(size_t size, const ALLOCATOR& alloc = ALLOCATOR()) noexcept
+		{
+			std::vector<T, ALLOCATOR> result(alloc);
+			generate_stream<T>(result, size);
+			return result;
+		}
+#ifdef __cpp_lib_memory_resource
+		/// <summary>
+		/// Generate a random stream of bytes on a memory resource.
+		/// </summary>
+		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
+		/// <param name="size">The number of elements of the vector to generate</param>
+		/// <param name="resource">The memory resource of the vector, ex: a 'std::pmr::monotonic_buffer_resource'</param>
+		/// <returns>A vector of random elements</returns>
+		template<class T = uint8_t> forceinline std::pmr::vector<T> generate_stream(size_t size, std::pmr::memory_resource* resource) noexcept
+		{
+			return generate_stream<T>(size, std::pmr::polymorphic_allocator<T>(resource));
+		}
+#endif
+		/// <summary>
+		/// Generate a random stream of bytes.
+		/// </summary>
+		/// <typeparam name="T">The type of elements on the vector to fill with random data</typeparam>
+		/// <param name="vec">out: A vector of random elements, keeps its allocator</param>
+		/// <param name="size">The number of elements of the vector to generate</param>
+		template<class T = uint8_t, class ALLOCATOR> void generate_stream(std::vector<T, ALLOCATOR>& vec, size_t size) noexcept
+		{
+			size_t sizeOf64 = (size * sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t); // The number of 64-bits numbers to generate
+
+			// Create the memory on the vector: always whole 64-bits numbers
+			vec.resize((sizeOf64 * sizeof(uint64_t) + sizeof(T) - 1) / sizeof(T));
+			internal::wyrand_stream<LANES>(&state, reinterpret_cast<uint8_t*>(vec.data()), sizeOf64);
+
+			// Final size
+			vec.resize(size);
+		}
+#ifdef __cpp_lib_span
+		/// <summary>
+		/// Generate a random stream of bytes.
+		/// </summary>
+		/// <typeparam name="T">The type of elements on the span to fill with random data</typeparam>
+		/// <param name="data">out: A span of random elements</param>
+		template<class T = uint8_t> void generate_stream(std::span<T> data) noexcept
+		{
+			internal::wyrand_fill<LANES>(&state, reinterpret_cast<uint8_t*>(data.data()), data.size_bytes());
+		}
+#endif
+	};
+	using rand_x4 = rand_lanes<4>;
+	using rand_x8 = rand_lanes<8>;
+
+	namespace internal
+	{
+		// Seed of all the 'thread_rand()' generators: one 'std::random_device' call by process, on first use
+		inline uint64_t thread_rand_seed() noexcept
+		{
+			static const uint64_t seed = rand().state;
+			return seed;
+		}
+		inline std::atomic<uint64_t> thread_rand_count{ 0 };// The number of threads that used 'thread_rand()'
+	}
+
+	/// <summary>
+	/// Get the generator of the current thread, without the 'std::random_device' call of 'wy::rand()' on each construction.
+	/// Thread i (in order of first use) gets the substream i of one process seed, so threads never overlap.
+	/// </summary>
+	/// <returns>A thread-local generator, initialized on the first call of each thread</returns>
+	inline rand& thread_rand() noexcept
+	{
+		thread_local rand r = rand(internal::thread_rand_seed()).substream(internal::thread_rand_count.fetch_add(1, std::memory_order_relaxed) & (rand::max_substreams - 1));
+		return r;
+	}
+
+	/// <summary>
+	/// Pseudo random numbers generator shared by many threads without locks: each value costs one 'fetch_add' on the state,
+	/// as the wyrand state update is additive. The values handed out are the sequence of 'wy::rand' with the same seed.
+	/// </summary>
+	struct alignas(64) atomic_rand
+	{
+		std::atomic<uint64_t> state;// Alone on its cache line, so neighbour data doesn't slow down the threads
+
+		////////////////////////////////////////////////////////////////////////////////////
+		// UniformRandomBitGenerator requirenment
+		////////////////////////////////////////////////////////////////////////////////////
+		using result_type = uint64_t;
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT64_MAX; }
+		/// <summary>
+		/// Returns a random value in the closed interval [0, UINT64_MAX]. Thread-safe.
+		/// </summary>
+		/// <returns>A new 64-bit pseudo-random value</returns>
+		forceinline uint64_t operator()() noexcept
+		{
+			uint64_t s = state.fetch_add(0xa0761d6478bd642full, std::memory_order_relaxed) + 0xa0761d6478bd642full;
+			return internal::_wymix(s, s ^ 0xe7037ed1a0b428dbull);
+		}
+		////////////////////////////////////////////////////////////////////////////////////
+
+		/// <summary>
+		/// Construct a shared generator with a random seed
+		/// </summary>
+		atomic_rand() noexcept : state(rand().state)
+		{}
+		/// <summary>
+		/// Construct a shared generator with a given seed
+		/// </summary>
+		/// <param name="seed">The seed, same sequence as 'wy::rand(seed)'</param>
+		atomic_rand(uint64_t seed) noexcept : state(seed)
+		{}
+
+		/// <summary>
+		/// Advance the generator in O(1). Thread-safe.
+		/// </summary>
+		/// <param name="n">The number of values to skip</param>
+		forceinline void discard(uint64_t n) noexcept
+		{
+			state.fetch_add(n * 0xa0761d6478bd642full, std::memory_order_relaxed);
+		}
+		/// <summary>
+		/// Take the next 'n' values of the sequence at once, as a private generator: one 'fetch_add' for all of them. Thread-safe.
+		/// </summary>
+		/// <param name="n">The number of values reserved</param>
+		/// <returns>A generator whose first 'n' values are reserved to the caller</returns>
+		forceinline rand reserve(uint64_t n) noexcept
+		{
+			return rand(state.fetch_add(n * 0xa0761d6478bd642full, std::memory_order_relaxed));
+		}
+	};
+
+#ifdef __cpp_lib_span
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Shuffle and sampling
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	namespace internal
+	{
+		// Run 'task(i)' for i in [0, num_tasks) with up to 'num_threads' threads. 0 to use all hardware threads.
+		// Without 'WY_THREADS' the calling thread runs all the tasks
+		template<class TASK> void parallel_tasks(size_t num_tasks, unsigned num_threads, TASK task) noexcept
+		{
+#if WY_THREADS
+			std::atomic<size_t> next_task = 0;
+			auto worker = [&]() noexcept {
+				for (size_t i = next_task++; i < num_tasks; i = next_task++)
+					task(i);
+			};
+			num_threads = num_threads_to_use(num_threads);
+			if (num_threads > num_tasks) num_threads = static_cast<unsigned>(num_tasks);
+
+			std::vector<std::thread> threads;
+			for (unsigned i = 1; i < num_threads; i++)
+			{
+				try { threads.emplace_back(worker); }
+				catch (...) { break; }// The current thread runs the tasks left
+			}
+			worker();
+			for (auto& t : threads)
+				t.join();
+#else
+			(void)num_threads;
+			for (size_t i = 0; i < num_tasks; i++)
+				task(i);
+#endif
+		}
+
+		// Unbiased random values in [0, range1) and [0, range2) from one random number in the common case:
+		// the leftover bits of the first bounded multiply feed the second (Brackett-Rozinsky & Lemire). 'range1 * range2' must fit in 64 bits
+		static forceinline void uniform_dist_2(rand& r, uint64_t range1, uint64_t range2, uint64_t& val1, uint64_t& val2) noexcept
+		{
+			uint64_t product = range1 * range2;
+			uint64_t random = r();
+			val1 = _wymulhi(random, range1);
+			uint64_t leftover = random * range1;
+			val2 = _wymulhi(leftover, range2);
+			leftover *= range2;
+			if (_unlikely_(leftover < product))
+			{
+				uint64_t threshold = (0 - product) % product;
+				while (leftover < threshold)
+				{
+					random = r();
+					val1 = _wymulhi(random, range1);
+					leftover = random * range1;
+					val2 = _wymulhi(leftover, range2);
+					leftover *= range2;
+				}
+			}
+		}
+
+		// Fisher-Yates shuffle, two positions by random number
+		template<class T> void fisher_yates(T* data, size_t size, rand& r) noexcept
+		{
+			using std::swap;
+			size_t i = size;
+			for (; i > (1ull << 32); i--)// 'i * (i - 1)' overflows: one position by random number
+				swap(data[i - 1], data[r.uniform_dist_unbiased(i)]);
+			for (; i > 1; i -= 2)
+			{
+				uint64_t j0, j1;
+				uniform_dist_2(r, i, i - 1, j0, j1);
+				swap(data[i - 1], data[j0]);
+				swap(data[i - 2], data[j1]);
+			}
+		}
+
+		// Merge two shuffled consecutive parts [0, mid) and [mid, size) into one shuffled (MergeShuffle, Bacher et al.)
+		template<class T> void merge_shuffled(T* data, size_t mid, size_t size, rand& r) noexcept
+		{
+			using std::swap;
+			size_t i = 0, j = mid;
+			uint64_t bits = 0;
+			for (unsigned num_bits = 0;; i++, num_bits--)
+			{
+				if (num_bits == 0) { bits = r(); num_bits = 64; }
+				bool from_second = bits & 1;
+				bits >>= 1;
+				if (from_second)
+				{
+					if (j == size) break;
+					swap(data[i], data[j++]);
+				}
+				else if (i == j)
+					break;
+			}
+			// One part is exhausted: insert the elements left at random positions
+			for (; i < size; i++)
+				swap(data[i], data[r.uniform_dist_unbiased(i + 1)]);
+		}
+
+		static constexpr size_t min_parallel_tile = 1 << 15;// Elements by thread below which shuffling is not worth a thread
+	}
+
+	/// <summary>
+	/// Shuffle the elements randomly, uniform over all permutations.
+	/// Faster than 'std::shuffle' with 'wy::rand': no 'uniform_int_distribution' and two positions by random number.
+	/// </summary>
+	/// <param name="data">in/out: The elements to shuffle</param>
+	/// <param name="r">in/out: The random generator</param>
+	template<class T> void shuffle(std::span<T> data, rand& r) noexcept
+	{
+		internal::fisher_yates(data.data(), data.size(), r);
+	}
+	/// <summary>
+	/// Shuffle the elements randomly using many threads: tiles are shuffled in parallel with substreams of 'r'
+	/// and merged by pairs (MergeShuffle). Uniform over all permutations. The result depends on 'r' and the number of tiles,
+	/// a power of two of at most 'num_threads'. Then 'r' is advanced after the substreams used.
+	/// </summary>
+	/// <param name="data">in/out: The elements to shuffle</param>
+	/// <param name="r">in/out: The random generator</param>
+	/// <param name="num_threads">The number of threads to use. 0 to use all hardware threads (1 without 'WY_THREADS')</param>
+	template<class T> void shuffle(std::span<T> data, rand& r, unsigned num_threads) noexcept
+	{
+		num_threads = internal::num_threads_to_use(num_threads);
+		size_t num_tiles = 1;
+		while (num_tiles * 2 <= num_threads && data.size() / (num_tiles * 2) >= internal::min_parallel_tile)
+			num_tiles *= 2;
+		if (num_tiles == 1)
+			return shuffle(data, r);
+
+		std::vector<rand> rands = r.split(num_tiles);
+		auto tile_start = [&](size_t i) { return data.size() / num_tiles * i; };
+		auto tile_end = [&](size_t i) { return i == num_tiles - 1 ? data.size() : tile_start(i + 1); };
+		internal::parallel_tasks(num_tiles, num_threads, [&](size_t i) noexcept {
+			internal::fisher_yates(data.data() + tile_start(i), tile_end(i) - tile_start(i), rands[i]);
+		});
+		for (size_t width = 1; width < num_tiles; width *= 2)
+			internal::parallel_tasks(num_tiles / (2 * width), num_threads, [&](size_t pair) noexcept {
+				size_t first = pair * 2 * width, start = tile_start(first);
+				internal::merge_shuffled(data.data() + start, tile_start(first + width) - start, tile_end(first + 2 * width - 1) - start, rands[first]);
+			});
+		r = r.substream(num_tiles);
+	}
+
+	/// <summary>
+	/// Select 'k' elements at random without replacement, in one pass (reservoir sampling, Algorithm L by Li).
+	/// The random numbers needed are proportional to 'k * log(size / k)', not to the size: the elements are skipped in bulk
+	/// and it works with any input range, also when its size is unknown.
+	/// </summary>
+	/// <param name="range">The elements to select from</param>
+	/// <param name="k">The number of elements to select</param>
+	/// <param name="r">in/out: The random generator</param>
+	/// <returns>The selected elements in no particular order. All the elements if there are 'k' or less</returns>
+	template<class RANGE> auto sample(const RANGE& range, size_t k, rand& r)
+	{
+		using std::begin, std::end;
+		auto it = begin(range);
+		auto last = end(range);
+		using iterator = decltype(it);
+		std::vector<std::remove_cv_t<std::remove_reference_t<decltype(*it)>>> reservoir;
+		reservoir.reserve(k);
+
+		for (; reservoir.size() < k && it != last; ++it)
+			reservoir.push_back(*it);
+		if (k == 0 || it == last)
+			return reservoir;
+
+		double w = std::exp(-r.exponential_dist() / k);// log(U) == -exponential
+		for (;;)
+		{
+			// Skip the elements that don't enter the reservoir
+			double skip = std::floor(-r.exponential_dist() / std::log1p(-w));
+			if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<iterator>::iterator_category>)
+			{
+				if (skip >= static_cast<double>(last - it))
+					break;
+				it += static_cast<typename std::iterator_traits<iterator>::difference_type>(skip);
+			}
+			else
+			{
+				for (uint64_t n = skip < 1.8e19 ? static_cast<uint64_t>(skip) : UINT64_MAX; n && it != last; n--)
+					++it;
+				if (it == last)
+					break;
+			}
+
+			reservoir[r.uniform_dist_unbiased(k)] = *it;
+			++it;
+			w *= std::exp(-r.exponential_dist() / k);
+		}
+		return reservoir;
+	}
+	/// <summary>
+	/// Select 'k' elements at random without replacement using many threads: each tile of 'data' is sampled in parallel
+	/// with a substream of 'r', and the samples are combined in proportion to the tile sizes.
+	/// </summary>
+	/// <param name="data">The elements to select from</param>
+	/// <param name="k">The number of elements to select</param>
+	/// <param name="r">in/out: The random generator</param>
+	/// <param name="num_threads">The number of threads to use. 0 to use all hardware threads (1 without 'WY_THREADS')</param>
+	/// <returns>The selected elements in no particular order. All the elements if there are 'k' or less</returns>
+	template<class T> std::vector<std::remove_cv_t<T>> sample(std::span<T> data, size_t k, rand& r, unsigned num_threads)
+	{
+		num_threads = internal::num_threads_to_use(num_threads);
+		size_t num_tiles = data.size() < num_threads ? data.size() : num_threads;
+		if (num_tiles <= 1 || data.size() <= k)
+			return sample(data, k, r);
+
+		// The sample of each tile, in random order
+		std::vector<rand> rands = r.split(num_tiles + 1);
+		std::vector<std::vector<std::remove_cv_t<T>>> samples(num_tiles);
+		auto tile_start = [&](size_t i) { return data.size() / num_tiles * i; };
+		auto tile_end = [&](size_t i) { return i == num_tiles - 1 ? data.size() : tile_start(i + 1); };
+		internal::parallel_tasks(num_tiles, num_threads, [&](size_t i) noexcept {
+			samples[i] = sample(data.subspan(tile_start(i), tile_end(i) - tile_start(i)), k, rands[i]);
+			internal::fisher_yates(samples[i].data(), samples[i].size(), rands[i]);
+		});
+
+		// How many elements of each tile: the tile of each of the 'k' selected elements, without replacement
+		std::vector<size_t> remaining(num_tiles), taken(num_tiles);
+		for (size_t i = 0; i < num_tiles; i++)
+			remaining[i] = tile_end(i) - tile_start(i);
+		for (size_t n = 0, total = data.size(); n < k; n++, total--)
+		{
+			uint64_t pos = rands[num_tiles].uniform_dist_unbiased(total);
+			size_t tile = 0;
+			for (; pos >= remaining[tile]; tile++)
+				pos -= remaining[tile];
+			remaining[tile]--;
+			taken[tile]++;
+		}
+
+		std::vector<std::remove_cv_t<T>> result;
+		result.reserve(k);
+		for (size_t i = 0; i < num_tiles; i++)
+			result.insert(result.end(), samples[i].begin(), samples[i].begin() + static_cast<ptrdiff_t>(taken[i]));
+		r = r.substream(num_tiles + 1);
+		return result;
+	}
+
+	/// <summary>
+	/// Weighted sampling: index i is selected with probability 'weights[i] / sum(weights)' in O(1) (alias method, Vose).
+	/// Each sample uses one random number: the high bits select a column and the low bits choose between the column and its alias.
+	/// </summary>
+	class alias_table
+	{
+	public:
+		/// <summary>
+		/// Build the table
+		/// </summary>
+		/// <param name="weights">The weights of each index, not negative</param>
+		/// <exception cref="std::invalid_argument">Thrown when there are no weights or they don't sum a positive value</exception>
+		explicit alias_table(std::span<const double> weights)
+		{
+			double sum = 0;
+			for (double w : weights)
+			{
+				if (!(w >= 0))
+					throw std::invalid_argument("wy::alias_table: the weights must not be negative");
+				sum += w;
+			}
+			if (!(sum > 0) || !std::isfinite(sum))
+				throw std::invalid_argument("wy::alias_table: the weights must have a positive and finite sum");
+
+			size_t n = weights.size();
+			std::vector<double> scaled(n);
+			std::vector<size_t> small, large;
+			for (size_t i = 0; i < n; i++)
+			{
+				scaled[i] = weights[i] * n / sum;
+				(scaled[i] < 1 ? small : large).push_back(i);
+			}
+
+			entries.resize(n);
+			while (!small.empty() && !large.empty())
+			{
+				size_t s = small.back(), l = large.back();
+				small.pop_back();
+				entries[s] = { to_threshold(scaled[s]), l };
+				scaled[l] -= 1 - scaled[s];
+				if (scaled[l] < 1)
+				{
+					large.pop_back();
+					small.push_back(l);
+				}
+			}
+			// The rest have probability 1, up to rounding errors
+			for (size_t i : large) entries[i] = { UINT64_MAX, i };
+			for (size_t i : small) entries[i] = { UINT64_MAX, i };
+		}
+
+		/// <summary>
+		/// The number of indexes
+		/// </summary>
+		size_t size() const noexcept
+		{
+			return entries.size();
+		}
+
+		/// <summary>
+		/// Select an index at random
+		/// </summary>
+		/// <param name="r">in/out: The random generator</param>
+		/// <returns>The index, in [0, size())</returns>
+		forceinline size_t operator()(rand& r) const noexcept
+		{
+			return select(r());
+		}
+		/// <summary>
+		/// Select many indexes at random, from blocks of random numbers generated as a stream
+		/// </summary>
+		/// <param name="out">out: The indexes</param>
+		/// <param name="r">in/out: The random generator</param>
+		template<class INDEX> void fill(std::span<INDEX> out, rand& r) const noexcept
+		{
+			uint64_t block[512];
+			for (size_t pos = 0; pos < out.size(); pos += std::size(block))
+			{
+				size_t block_size = out.size() - pos < std::size(block) ? out.size() - pos : std::size(block);
+				r.generate_stream(std::span<uint64_t>(block, block_size));
+				for (size_t i = 0; i < block_size; i++)
+				{
+#if WYHASH_LITTLE_ENDIAN
+					out[pos + i] = static_cast<INDEX>(select(block[i]));
+#else
+					out[pos + i] = static_cast<INDEX>(select(byteswap64(block[i])));
+#endif
+				}
+			}
+		}
+		/// <summary>
+		/// Select many indexes at random using many threads: tiles of 'out' are filled in parallel with substreams of 'r'
+		/// </summary>
+		/// <param name="out">out: The indexes</param>
+		/// <param name="r">in/out: The random generator</param>
+		/// <param name="num_threads">The number of threads to use. 0 to use all hardware threads</param>
+		template<class INDEX> void fill(std::span<INDEX> out, rand& r, unsigned num_threads) const noexcept
+		{
+			constexpr size_t tile_size = 1 << 16;
+			size_t num_tiles = (out.size() + tile_size - 1) / tile_size;
+			if (num_tiles > rand::max_substreams) num_tiles = rand::max_substreams;
+			if (num_tiles <= 1)
+				return fill(out, r);
+
+			size_t tile = (out.size() + num_tiles - 1) / num_tiles;
+			internal::parallel_tasks(num_tiles, num_threads, [&](size_t i) noexcept {
+				rand tile_rand = r.substream(i);
+				size_t start = i * tile;
+				fill(out.subspan(start, out.size() - start < tile ? out.size() - start : tile), tile_rand);
+			});
+			r = r.substream(num_tiles);
+		}
+
+	private:
+		struct entry
+		{
+			uint64_t threshold;// Select the column when the low bits are below, else the alias
+			size_t alias;
+		};
+		std::vector<entry> entries;
+
+		static uint64_t to_threshold(double probability) noexcept
+		{
+			return probability >= 1 ? UINT64_MAX : static_cast<uint64_t>(probability * 18446744073709551616.0);// * 2^64
+		}
+		forceinline size_t select(uint64_t random) const noexcept
+		{
+			size_t column = static_cast<size_t>(internal::_wymulhi(random, entries.size()));
+			const entry& e = entries[column];
+			size_t take_alias = 0 - static_cast<size_t>(random * entries.size() >= e.threshold);// Branchless: the choice is random
+			return column ^ ((column ^ e.alias) & take_alias);
+		}
+	};
+#endif
+
+	/// <summary>
+	/// A 128-bits hash
+	/// </summary>
+	struct digest128
+	{
+		uint64_t low;// Same as the 64-bits wyhash
+		uint64_t high;
+
+		bool operator==(const digest128& other) const noexcept { return low == other.low && high == other.high; }
+		bool operator!=(const digest128& other) const noexcept { return !(*this == other); }
+	};
+
+	/// <summary>
+	/// The secret of the hashers: 4 odd 64-bits words with 4 bits set by byte, each pair of words differing in exactly 32 bits.
+	/// Compute it once from a seed, then store, share or serialize it: building a hasher from a secret only copies it.
+	/// </summary>
+	struct secret
+	{
+		uint64_t words[4];
+
+		/// <summary>
+		/// Generate the secret of a seed, the same as 'wyhash.h::make_secret(seed, secret)'.
+		/// The last secrets generated by each thread are cached, as the generation takes microseconds.
+		/// </summary>
+		/// <param name="seed">The seed to generate the secret from</param>
+		/// <returns>The secret</returns>
+		static secret from_seed(uint64_t seed) noexcept
+		{
+			// Containers and shards usually reuse a few seeds
+			struct cache_entry { uint64_t seed; secret value; bool valid; };
+			thread_local cache_entry cache[16] = {};
+			cache_entry& entry = cache[(seed * 0x9e3779b97f4a7c15ull) >> 60];
+			if (!entry.valid || entry.seed != seed)
+				entry = { seed, generate(seed), true };
+			return entry.value;
+		}
+
+		/// <summary>
+		/// The secret of the hashers built without seed: the constants of wyhash, not generated so they don't have the
+		/// properties of the generated secrets
+		/// </summary>
+		static constexpr secret default_secret() noexcept
+		{
+			return { { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull } };
+		}
+
+		/// <summary>
+		/// Check the properties of a secret, ex: after deserialization. The default secret is valid too
+		/// </summary>
+		bool is_valid() const noexcept
+		{
+			if (*this == default_secret()) return true;
+			for (size_t i = 0; i < 4; i++)
+			{
+				if (words[i] % 2 == 0) return false;
+				for (size_t j = 0; j < 64; j += 8)
+					if (internal::_wypopcount((words[i] >> j) & 0xff) != 4) return false;
+				for (size_t j = 0; j < i; j++)
+					if (internal::_wypopcount(words[i] ^ words[j]) != 32) return false;
+			}
+			return true;
+		}
+
+		static constexpr size_t serialized_size = 32;
+		/// <summary>
+		/// The secret as bytes, in little endian order on all platforms
+		/// </summary>
+		std::array<uint8_t, serialized_size> serialize() const noexcept
+		{
+			std::array<uint8_t, serialized_size> bytes;
+			for (size_t i = 0; i < serialized_size; i++)
+				bytes[i] = static_cast<uint8_t>(words[i / 8] >> (i % 8 * 8));
+			return bytes;
+		}
+		/// <summary>
+		/// Read a secret saved with 'serialize()'
+		/// </summary>
+		/// <param name="data">The bytes</param>
+		/// <param name="len">The number of bytes, 'serialized_size'</param>
+		/// <returns>The secret, or empty if the bytes are not a valid secret</returns>
+		static std::optional<secret> deserialize(const uint8_t* data, size_t len) noexcept
+		{
+			if (len != serialized_size)
+				return std::nullopt;
+			secret result = {};
+			for (size_t i = 0; i < serialized_size; i++)
+				result.words[i / 8] |= static_cast<uint64_t>(data[i]) << (i % 8 * 8);
+			if (!result.is_valid())
+				return std::nullopt;
+			return result;
+		}
+
+		bool operator==(const secret& other) const noexcept
+		{
+			return memcmp(words, other.words, sizeof(words)) == 0;
+		}
+		bool operator!=(const secret& other) const noexcept
+		{
+			return !operator==(other);
+		}
+
+	private:
+		// code taken from 'wyhash.h::make_secret(seed, secret)'
+		static secret generate(uint64_t seed) noexcept
+		{
+			static constexpr uint8_t c[] = { 15, 23, 27, 29, 30, 39, 43, 45, 46, 51, 53, 54, 57, 58, 60, 71, 75, 77, 78, 83, 85, 86, 89, 90, 92, 99, 101, 102, 105, 106, 108, 113, 114, 116, 120, 135, 139, 141, 142, 147, 149, 150, 153, 154, 156, 163, 165, 166, 169, 170, 172, 177, 178, 180, 184, 195, 197, 198, 201, 202, 204, 209, 210, 212, 216, 225, 226, 228, 232, 240 };
+			secret result;
+			for (size_t i = 0; i < 4; i++) {
+				bool ok;
+				do {
+					// An even first byte fails: skip the other 7 random numbers of the candidate in O(1), same sequence as wyhash.h
+					uint64_t first = c[internal::wyrand(&seed) % sizeof(c)];
+					if (first % 2 == 0) { seed += 7 * 0xa0761d6478bd642full; ok = false; continue; }
+					result.words[i] = first;
+					for (size_t j = 8; j < 64; j += 8) result.words[i] |= static_cast<uint64_t>(c[internal::wyrand(&seed) % sizeof(c)]) << j;
+					ok = true;
+					for (size_t j = 0; j < i && ok; j++)
+						ok = internal::_wypopcount(result.words[j] ^ result.words[i]) == 32;
+				} while (!ok);
+			}
+			return result;
+		}
+	};
+
+	/// <summary>
+	/// Internal implementations
+	/// </summary>
+	namespace internal {
+		static constexpr uint64_t default_secret[4] = { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull };// the default secret parameters, as 'wy::secret::default_secret()'
+
+		/// <summary>
+		/// Hash base class
+		/// </summary>
+		struct hash_imp
+		{
+			uint64_t secret[4];// salted: We use dynamic secret to avoid intended attacks.
+
+			/// <summary>
+			/// Create a wyhasher with default secret
+			/// </summary>
+			hash_imp() noexcept : secret{ default_secret[0], default_secret[1], default_secret[2], default_secret[3] }
+			{}
+			/// <summary>
+			/// Create a wyhasher with secret generated from a seed. Cheap when the thread used the seed recently,
+			/// else prefer to generate the 'wy::secret' once and build the hashers from it.
+			/// </summary>
+			/// <param name="seed">The seed to generate the secret from</param>
+			hash_imp(uint64_t seed) noexcept : hash_imp(wy::secret::from_seed(seed))
+			{}
+			/// <summary>
+			/// Create a wyhasher with a precomputed secret: only copies it
+			/// </summary>
+			/// <param name="psecret">The secret to use</param>
+			hash_imp(const wy::secret& psecret) noexcept
+			{
+				memcpy(secret, psecret.words, sizeof(secret));
+			}
+			/// <summary>
+			/// Create a wyhasher with a specific secret
+			/// </summary>
+			/// <param name="secret">The secret to use</param>
+			hash_imp(const uint64_t psecret[4]) noexcept
+			{
+				memcpy(secret, psecret, sizeof(secret));
+			}
+
+			/// <summary>
+			/// Hash general data
+			/// </summary>
+			/// <param name="data">The data to hash</param>
+			/// <param name="len">The size of the data</param>
+			/// <returns>A 64-bits hash</returns>
+			forceinline uint64_t wyhash(const uint8_t* data, size_t len) const noexcept
+			{
+				// code taken from 'wyhash.h::wyhash(const void* key, size_t len, uint64_t seed, const uint64_t * secret)' with seed=0
+				const uint8_t* p = (const uint8_t*)data;
+				uint64_t seed = secret[0], a, b;
+				if (_likely_(len <= 16)) {
+					if (_likely_(len >= 4)) { a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2)); b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2)); }
+					else if (_likely_(len > 0)) { a = _wyr3(p, len); b = 0; }
+					else a = b = 0;
+				}
+				else {
+					size_t i = len;
+					if (_unlikely_(i > 48)) {
+						uint64_t see1 = seed, see2 = seed;
+						do {
+							seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);
+							see1 = _wymix(_wyr8(p + 16) ^ secret[2], _wyr8(p + 24) ^ see1);
+							see2 = _wymix(_wyr8(p + 32) ^ secret[3], _wyr8(p + 40) ^ see2);
+							p += 48; i -= 48;
+						} while (_likely_(i > 48));
+						seed ^= see1 ^ see2;
+					}
+					while (_unlikely_(i > 16)) { seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);  i -= 16; p += 16; }
+					a = _wyr8(p + i - 16);  b = _wyr8(p + i - 8);
+				}
+				return _wymix(secret[1] ^ len, _wymix(a ^ secret[1], b ^ seed));
+
+			}
+
+			/// <summary>
+			/// Hash general data to 128 bits.
+			/// The low half is the same as 'wyhash(data, len)'. The high half is a second lane: it takes the 48 bytes stripes
+			/// from the three accumulators of the main loop (that wyhash xors together) and keeps its own accumulator on
+			/// the 16 bytes tail loop, so it costs a few multiplies by hash whatever the size.
+			/// </summary>
+			/// <param name="data">The data to hash</param>
+			/// <param name="len">The size of the data</param>
+			/// <returns>A 128-bits hash</returns>
+			forceinline digest128 wyhash128(const uint8_t* data, size_t len) const noexcept
+			{
+				const uint8_t* p = (const uint8_t*)data;
+				uint64_t seed = secret[0], seed2 = secret[0] ^ secret[3], a, b;
+				if (_likely_(len <= 16)) {
+					if (_likely_(len >= 4)) { a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2)); b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2)); }
+					else if (_likely_(len > 0)) { a = _wyr3(p, len); b = 0; }
+					else a = b = 0;
+				}
+				else {
+					size_t i = len;
+					if (_unlikely_(i > 48)) {
+						uint64_t see1 = seed, see2 = seed;
+						do {
+							seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);
+							see1 = _wymix(_wyr8(p + 16) ^ secret[2], _wyr8(p + 24) ^ see1);
+							see2 = _wymix(_wyr8(p + 32) ^ secret[3], _wyr8(p + 40) ^ see2);
+							p += 48; i -= 48;
+						} while (_likely_(i > 48));
+						seed2 = _wymix(see1 ^ secret[3], see2 ^ seed);// Other combination of the accumulators
+						seed ^= see1 ^ see2;
+					}
+					while (_unlikely_(i > 16)) {
+						uint64_t r0 = _wyr8(p), r1 = _wyr8(p + 8);
+						seed = _wymix(r0 ^ secret[1], r1 ^ seed);
+						seed2 = _wymix(r0 ^ secret[2], r1 ^ seed2);
+						i -= 16; p += 16;
+					}
+					a = _wyr8(p + i - 16);  b = _wyr8(p + i - 8);
+				}
+				return { _wymix(secret[1] ^ len, _wymix(a ^ secret[1], b ^ seed)), _wymix(secret[2] ^ len, _wymix(a ^ secret[2], b ^ seed2)) };
+			}
+
+			/// <summary>
+			/// Hash data of a size known at compile time.
+			/// Same result as 'wyhash(data, N)', but the size classes are selected at compile time and the loops have constant trip counts.
+			/// </summary>
+			/// <typeparam name="N">The size of the data</typeparam>
+			/// <param name="data">The data to hash</param>
+			/// <returns>A 64-bits hash</returns>
+			template<size_t N> forceinline uint64_t wyhash_fixed(const uint8_t* data) const noexcept
+			{
+				const uint8_t* p = data;
+				uint64_t seed = secret[0], a, b;
+				if constexpr (N <= 16) {
+					if constexpr (N >= 4) { a = (_wyr4(p) << 32) | _wyr4(p + ((N >> 3) << 2)); b = (_wyr4(p + N - 4) << 32) | _wyr4(p + N - 4 - ((N >> 3) << 2)); }
+					else if constexpr (N > 0) { a = _wyr3(p, N); b = 0; }
+					else a = b = 0;
+				}
+				else {
+					constexpr size_t blocks48 = N > 48 ? (N - 1) / 48 : 0;// Iterations of the 48 bytes loop
+					constexpr size_t rest48 = N - 48 * blocks48;
+					constexpr size_t blocks16 = (rest48 - 1) / 16;// Iterations of the 16 bytes loop
+					constexpr size_t rest16 = rest48 - 16 * blocks16;
+					if constexpr (blocks48 > 0) {
+						uint64_t see1 = seed, see2 = seed;
+						for (size_t i = 0; i < blocks48; i++, p += 48) {
+							seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);
+							see1 = _wymix(_wyr8(p + 16) ^ secret[2], _wyr8(p + 24) ^ see1);
+							see2 = _wymix(_wyr8(p + 32) ^ secret[3], _wyr8(p + 40) ^ see2);
+						}
+						seed ^= see1 ^ see2;
+					}
+					for (size_t i = 0; i < blocks16; i++, p += 16)
+						seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);
+					a = _wyr8(p + rest16 - 16);  b = _wyr8(p + rest16 - 8);
+				}
+				return _wymix(secret[1] ^ N, _wymix(a ^ secret[1], b ^ seed));
+			}
+
+			/// <summary>
+			/// Hash many independent keys in one call.
+			/// There is no dependency between keys, so the multiplications of consecutive keys overlap on the pipeline.
+			/// Results are identical to calling 'wyhash(ptrs[i], lens[i])' for each key.
+			/// </summary>
+			/// <param name="ptrs">The pointers to the keys</param>
+			/// <param name="lens">The sizes of the keys</param>
+			/// <param name="out">out: The 64-bits hashes, one by key</param>
+			/// <param name="n">The number of keys</param>
+			forceinline void wyhash_batch(const uint8_t* const* ptrs, const size_t* lens, uint64_t* out, size_t n) const noexcept
+			{
+				for (size_t i = 0; i < n; i++)
+					out[i] = wyhash(ptrs[i], lens[i]);
+			}
+			/// <summary>
+			/// Hash a 64-bit number
+			/// </summary>
+			/// <param name="number">The number to hash</param>
+			/// <returns>A 64-bits hash</returns>
+			forceinline uint64_t wyhash(uint64_t number) const noexcept
+			{
+				return internal::wyhash64(number, secret[0]);
+			}
+
+			/// <summary>
+			/// Mix the bits of a field into a running hash, for composite keys
+			/// </summary>
+			/// <param name="hash">The hash of the previous fields</param>
+			/// <param name="field">The bits (or hash) of the field</param>
+			/// <returns>The new running hash</returns>
+			forceinline uint64_t combine(uint64_t hash, uint64_t field) const noexcept
+			{
+				return _wymix(hash ^ secret[1], field ^ secret[2]);
+			}
+		};
+
+		// Character type of a string, without instantiating it (std::pmr strings may be incomplete here)
+		template<class STRING_TYPE> struct string_char;
+		template<class CHAR, class... REST> struct string_char<std::basic_string<CHAR, REST...>> { using type = CHAR; };
+#if __cpp_lib_string_view
+		template<class CHAR, class... REST> struct string_char<std::basic_string_view<CHAR, REST...>> { using type = CHAR; };
+#endif
+
+		/// <summary>
+		/// Hash base class for string types
+		/// </summary>
+		/// <typeparam name="STRING_TYPE">The type of the string, ex: std::string, std::wstring, ...</typeparam>
+		template<class STRING_TYPE> struct hash_string_base : private hash_imp
+		{
+			using hash_imp::hash_imp;// Inherit constructors
+			using char_type = typename string_char<STRING_TYPE>::type;
+#if __cpp_lib_string_view
+			using is_transparent = void;// Heterogeneous lookup: strings with the same characters hash the same whatever their type
+#endif
+
+			forceinline uint64_t operator()(const STRING_TYPE& elem) const noexcept
+			{
+				return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(elem.data()), sizeof(char_type) * elem.size());
+			}
+#if __cpp_lib_string_view
+			/// <summary>
+			/// Hash any string with the same character type without creating a temporary STRING_TYPE:
+			/// C-strings, string views and strings with other allocators, like std::pmr strings
+			/// </summary>
+			/// <param name="elem">The string to hash</param>
+			/// <returns>A 64-bits hash, the same as the STRING_TYPE with the same characters</returns>
+			template<class S, class = std::enable_if_t<!std::is_same_v<S, STRING_TYPE> && std::is_convertible_v<const S&, std::basic_string_view<char_type>>>>
+			forceinline uint64_t operator()(const S& elem) const noexcept
+			{
+				std::basic_string_view<char_type> view = elem;
+				return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(view.data()), sizeof(char_type) * view.size());
+			}
+#endif
+			/// <summary>
+			/// Hash many strings in one call
+			/// </summary>
+			/// <param name="elems">The strings to hash</param>
+			/// <param name="out">out: The 64-bits hashes, one by string</param>
+			/// <param name="n">The number of strings</param>
+			void hash_batch(const STRING_TYPE* elems, uint64_t* out, size_t n) const noexcept
+			{
+				for (size_t i = 0; i < n; i++)
+					out[i] = operator()(elems[i]);
+			}
+		};
+	};
+
+	/// <summary>
+	/// Incremental wyhash for data that is not in contiguous memory.
+	/// Feeding the data in any number of chunks produces the same digest as the one-shot 'wyhash'.
+	/// </summary>
+	struct hash_stream : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+
+		/// <summary>
+		/// Add data to the hash
+		/// </summary>
+		/// <param name="data">The data to hash</param>
+		/// <param name="len">The size of the data</param>
+		void update(const uint8_t* data, size_t len) noexcept
+		{
+			total_len += len;
+			if (pending + len <= 48)
+			{
+				if (len) memcpy(buffer + 16 + pending, data, len);
+				pending += len;
+				return;
+			}
+
+			// More than 48 bytes available: at least one stripe is processed
+			// and between 1 and 48 bytes stay pending, like in the one-shot version
+			if (pending)
+			{
+				size_t fill = 48 - pending;
+				memcpy(buffer + 16 + pending, data, fill);
+				data += fill; len -= fill;
+				stripe(buffer + 16);
+				memcpy(buffer, buffer + 48, 16);
+			}
+			if (len > 48)
+			{
+				do {
+					stripe(data);
+					data += 48; len -= 48;
+				} while (len > 48);
+				memcpy(buffer, data - 16, 16);
+			}
+			memcpy(buffer + 16, data, len);
+			pending = len;
+		}
+#ifdef __cpp_lib_span
+		/// <summary>
+		/// Add data to the hash
+		/// </summary>
+		/// <param name="data">The data to hash</param>
+		void update(std::span<const uint8_t> data) noexcept
+		{
+			update(data.data(), data.size());
+		}
+#endif
+		/// <summary>
+		/// Get the hash of all the data added. More data can be added after this call.
+		/// </summary>
+		/// <returns>A 64-bits hash</returns>
+		uint64_t finish() const noexcept
+		{
+			// code taken from 'hash_imp::wyhash(const uint8_t* data, size_t len)'
+			const uint8_t* p = buffer + 16;
+			uint64_t seed = see0, a, b;
+			if (_likely_(total_len <= 16)) {
+				if (_likely_(total_len >= 4)) { a = (internal::_wyr4(p) << 32) | internal::_wyr4(p + ((total_len >> 3) << 2)); b = (internal::_wyr4(p + total_len - 4) << 32) | internal::_wyr4(p + total_len - 4 - ((total_len >> 3) << 2)); }
+				else if (_likely_(total_len > 0)) { a = internal::_wyr3(p, total_len); b = 0; }
+				else a = b = 0;
+			}
+			else {
+				size_t i = pending;
+				if (_unlikely_(total_len > 48)) seed ^= see1 ^ see2;
+				while (_unlikely_(i > 16)) { seed = internal::_wymix(internal::_wyr8(p) ^ secret[1], internal::_wyr8(p + 8) ^ seed);  i -= 16; p += 16; }
+				// When less than 16 bytes are pending this reads the end of the last stripe
+				a = internal::_wyr8(p + i - 16);  b = internal::_wyr8(p + i - 8);
+			}
+			return internal::_wymix(secret[1] ^ total_len, internal::_wymix(a ^ secret[1], b ^ seed));
+		}
+		/// <summary>
+		/// Start a new hash with the same secret
+		/// </summary>
+		void reset() noexcept
+		{
+			see0 = see1 = see2 = secret[0];
+			total_len = 0;
+			pending = 0;
+		}
+
+	private:
+		uint64_t see0 = secret[0], see1 = secret[0], see2 = secret[0];// The state of the 3 lanes of the stripe loop
+		uint64_t total_len = 0;// The number of bytes added
+		size_t pending = 0;// The number of bytes in the buffer not yet processed
+		uint8_t buffer[16 + 48];// The last 16 bytes processed followed by the pending bytes
+
+		forceinline void stripe(const uint8_t* p) noexcept
+		{
+			see0 = internal::_wymix(internal::_wyr8(p) ^ secret[1], internal::_wyr8(p + 8) ^ see0);
+			see1 = internal::_wymix(internal::_wyr8(p + 16) ^ secret[2], internal::_wyr8(p + 24) ^ see1);
+			see2 = internal::_wymix(internal::_wyr8(p + 32) ^ secret[3], internal::_wyr8(p + 40) ^ see2);
+		}
+	};
+
+	/// <summary>
+	/// 128-bits wyhash of bytes, for content addressing and deduplication of billions of items where 64 bits collide.
+	/// The low 64 bits are the same as wy::hash of the bytes (with the same secret).
+	/// </summary>
+	struct hash128 : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+
+		forceinline digest128 operator()(const uint8_t* data, size_t len) const noexcept { return hash_imp::wyhash128(data, len); }
+#ifdef __cpp_lib_span
+		forceinline digest128 operator()(std::span<const uint8_t> data) const noexcept { return hash_imp::wyhash128(data.data(), data.size()); }
+#endif
+#if __cpp_lib_string_view
+		forceinline digest128 operator()(std::string_view data) const noexcept { return hash_imp::wyhash128(reinterpret_cast<const uint8_t*>(data.data()), data.size()); }
+#endif
+	};
+
+	namespace internal {
+		void wy_fields() = delete;// Only found by ADL: the field list declared by the user for a type
+
+		// The user declared 'wy_fields(const T&)' returning a std::tuple of the fields to hash, usually with std::tie
+		template<class T, class = void> struct has_field_list : std::false_type {};
+		template<class T> struct has_field_list<T, std::void_t<decltype(wy_fields(std::declval<const T&>()))>> : std::true_type {};
+
+		template<class TUPLE> uint64_t hash_tuple_fields(const hash_imp& hasher, const TUPLE& fields) noexcept;
+
+		// std::array and others with the tuple protocol: hashed by wy::hash
+		template<class T, class = void> struct is_tuple_like : std::false_type {};
+		template<class T> struct is_tuple_like<T, std::void_t<decltype(std::tuple_size<T>::value)>> : std::true_type {};
+		// Aggregates whose bytes are not their value (padding, floats, strings...): hashed by their fields with wy::aggregate_hash
+		template<class T> constexpr bool is_fields_aggregate_v = std::is_aggregate_v<T> && std::is_class_v<T> && !is_tuple_like<T>::value &&
+			!std::has_unique_object_representations_v<T> && !has_field_list<T>::value;
+	}
+	template<class T> struct aggregate_hash;
+
+	/// <summary>
+	/// Common wyhash for general use. Hash the bytes of the type, or the fields returned by 'wy_fields(const T&)' if declared.
+	/// NOTE: The bytes of padding are undefined, so use 'wy::aggregate_hash' or declare 'wy_fields' for types with padding.
+	/// </summary>
+	/// <typeparam name="T">Type of the element to hash</typeparam>
+	template<class T> struct hash : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+
+		/// <summary>
+		/// Hash a general type
+		/// </summary>
+		/// <param name="elem">The element to hash</param>
+		/// <returns>A 64-bits hash</returns>
+        forceinline uint64_t operator()(const T& elem) const noexcept
+        {
+            static_assert(sizeof(T) > 0, "Type to hash T should have variables");
+#if __cpp_lib_ranges
+			// Views iterated only as non-const (std::views::filter, drop_while...) would hash the bytes of the view object
+			static_assert(!std::ranges::range<T> || std::ranges::input_range<const T>, "wy::hash: the range can't be iterated as const, hash a std::vector of its elements");
+#endif
+
+			if constexpr (internal::has_field_list<T>::value) return internal::hash_tuple_fields(*this, wy_fields(elem));
+			else if constexpr (sizeof(T) ==  4) return hash_imp::wyhash(internal::_wyr4(&elem));
+			else if constexpr (sizeof(T) ==  8) return hash_imp::wyhash(internal::_wyr8(&elem));
+			else if constexpr (sizeof(T) == 16) return internal::wyhash64(internal::_wyr8(&elem), internal::_wyr8(reinterpret_cast<const uint8_t*>(&elem) + 8));
+			else return hash_imp::wyhash_fixed<sizeof(T)>(reinterpret_cast<const uint8_t*>(&elem));// Also C arrays and others fixed size types (std::array without ranges)
+        }
+	};
+	/// <summary>
+	/// Partial specialization for pointer
+	/// </summary>
+	/// <typeparam name="T">Type of elements</typeparam>
+	template<class T> struct hash<T*> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const T* elem) const noexcept
+		{
+			static_assert(sizeof(T) > 0, "Type to hash T should have variables");
+			return hash_imp::wyhash_fixed<sizeof(T)>(reinterpret_cast<const uint8_t*>(elem));
+		}
+	};
+
+	namespace internal {
+		/// <summary>
+		/// The 64 bits to combine for a field: integer, enum and pointer values are used directly, floating point by value,
+		/// aggregates with padding are walked by wy::aggregate_hash, others are hashed with their wy::hash. All use the secret
+		/// of 'hasher' (the default secret for user hashers that can't take one).
+		/// NOTE: Classes with constructors are hashed by wy::hash, as bytes if not specialized: declare 'wy_fields' if they have padding.
+		///       As in wy::aggregate_hash, aggregates with C arrays or fields on base classes need 'wy_fields'.
+		///       Floating point: -0.0 and +0.0 hash the same, NaNs (never equal to themselves) hash by their bits.
+		/// </summary>
+		template<class F> forceinline uint64_t field_bits(const hash_imp& hasher, const F& field) noexcept
+		{
+			if constexpr (std::is_floating_point_v<F> && sizeof(F) <= 8)
+			{
+				F value = field == 0 ? F(0) : field;
+				uint64_t bits = 0;
+				memcpy(&bits, &value, sizeof(F));
+				return bits;
+			}
+			else if constexpr (std::is_floating_point_v<F>)
+			{
+				// long double has padding (10 bytes of value in 16 on x86-64): split the value in two doubles, exact for the
+				// 64-bits significand of x87 and deterministic for wider formats
+				double high = field == 0 ? 0.0 : static_cast<double>(field);
+				double low = std::isfinite(field) ? static_cast<double>(field - static_cast<F>(high)) : 0.0;
+				return hasher.combine(field_bits(hasher, high), field_bits(hasher, low));
+			}
+			else if constexpr ((std::is_arithmetic_v<F> || std::is_enum_v<F> || std::is_pointer_v<F>) && sizeof(F) <= 8)
+			{
+				uint64_t bits = 0;
+				memcpy(&bits, &field, sizeof(F));
+				return bits;
+			}
+			else if constexpr (is_fields_aggregate_v<F>)
+				return aggregate_hash<F>(hasher.secret)(field);
+			else if constexpr (std::is_constructible_v<wy::hash<F>, const uint64_t*>)
+				return static_cast<uint64_t>(wy::hash<F>(hasher.secret)(field));
+			else
+				return static_cast<uint64_t>(wy::hash<F>()(field));
+		}
+	}
+
+	/// <summary>
+	/// Mix fields into a running hash, one multiply by field of at most 8 bytes (other fields are hashed with wy::hash first).
+	/// Starting from 'h = 0' is fine. To get the same hash as wy::hash of a std::tuple with the fields, start from
+	/// 'wy::internal::default_secret[0]'.
+	/// </summary>
+	/// <param name="h">in/out: The running hash</param>
+	/// <param name="fields">The fields to mix</param>
+	template<class... FIELDS> forceinline void hash_combine(uint64_t& h, const FIELDS&... fields) noexcept
+	{
+		internal::hash_imp hasher;
+		((h = hasher.combine(h, internal::field_bits(hasher, fields))), ...);
+	}
+	/// <summary>
+	/// Mix fields into a running hash with a secret: the mix and the wy::hash of the fields bigger than 8 bytes use it.
+	/// Start from 'psecret.words[0]' to get the same hash as a wy::hash of a std::tuple with the fields built from 'psecret'.
+	/// </summary>
+	/// <param name="psecret">The secret, for example from 'wy::secret::from_seed(seed)'</param>
+	/// <param name="h">in/out: The running hash</param>
+	/// <param name="fields">The fields to mix</param>
+	template<class... FIELDS> forceinline void hash_combine(const wy::secret& psecret, uint64_t& h, const FIELDS&... fields) noexcept
+	{
+		internal::hash_imp hasher(psecret);
+		((h = hasher.combine(h, internal::field_bits(hasher, fields))), ...);
+	}
+
+	namespace internal {
+		/// <summary>
+		/// Combine the fields of a tuple, same as the wy::hash of the tuple
+		/// </summary>
+		template<class TUPLE> forceinline uint64_t hash_tuple_fields(const hash_imp& hasher, const TUPLE& fields) noexcept
+		{
+			return std::apply([&hasher](const auto&... field) {
+				uint64_t h = hasher.secret[0];
+				((h = hasher.combine(h, field_bits(hasher, field))), ...);
+				return h;
+			}, fields);
+		}
+	}
+
+	/// <summary>
+	/// Partial specialization for std::tuple: combine the fields, without padding bytes or temporary buffers
+	/// </summary>
+	/// <typeparam name="T">Types of the fields</typeparam>
+	template<class... T> struct hash<std::tuple<T...>> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const std::tuple<T...>& elem) const noexcept
+		{
+			return std::apply([this](const T&... fields) {
+				uint64_t h = secret[0];
+				((h = combine(h, internal::field_bits(*this, fields))), ...);
+				return h;
+			}, elem);
+		}
+	};
+	/// <summary>
+	/// Partial specialization for std::pair, same hash as the std::tuple of the two fields
+	/// </summary>
+	template<class T1, class T2> struct hash<std::pair<T1, T2>> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const std::pair<T1, T2>& elem) const noexcept
+		{
+			return combine(combine(secret[0], internal::field_bits(*this, elem.first)), internal::field_bits(*this, elem.second));
+		}
+	};
+
+	namespace internal {
+		// Converts to any field type, to count the fields of an aggregate. Only used unevaluated
+		struct any_field { template<class F> operator F() const noexcept; };
+
+		template<class T, class INDEXES, class = void> struct is_brace_constructible : std::false_type {};
+		template<class T, size_t... I> struct is_brace_constructible<T, std::index_sequence<I...>, std::void_t<decltype(T{ (void(I), any_field{})... })>> : std::true_type {};
+
+		static constexpr size_t max_aggregate_fields = 16;
+		/// <summary>
+		/// The number of fields of an aggregate: the most initializers it accepts
+		/// </summary>
+		template<class T, size_t N = max_aggregate_fields> constexpr size_t num_fields() noexcept
+		{
+			if constexpr (N == 0 || is_brace_constructible<T, std::make_index_sequence<N>>::value) return N;
+			else return num_fields<T, N - 1>();
+		}
+
+		/// <summary>
+		/// Call 'f' with the fields of an aggregate, with structured bindings
+		/// </summary>
+		template<class T, class F> forceinline uint64_t visit_fields(const T& obj, F&& f) noexcept
+		{
+			constexpr size_t n = num_fields<T>();
+			if constexpr (n == 1) { const auto& [f0] = obj; return f(f0); }
+			else if constexpr (n == 2) { const auto& [f0, f1] = obj; return f(f0, f1); }
+			else if constexpr (n == 3) { const auto& [f0, f1, f2] = obj; return f(f0, f1, f2); }
+			else if constexpr (n == 4) { const auto& [f0, f1, f2, f3] = obj; return f(f0, f1, f2, f3); }
+			else if constexpr (n == 5) { const auto& [f0, f1, f2, f3, f4] = obj; return f(f0, f1, f2, f3, f4); }
+			else if constexpr (n == 6) { const auto& [f0, f1, f2, f3, f4, f5] = obj; return f(f0, f1, f2, f3, f4, f5); }
+			else if constexpr (n == 7) { const auto& [f0, f1, f2, f3, f4, f5, f6] = obj; return f(f0, f1, f2, f3, f4, f5, f6); }
+			else if constexpr (n == 8) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7); }
+			else if constexpr (n == 9) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8); }
+			else if constexpr (n == 10) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9); }
+			else if constexpr (n == 11) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10); }
+			else if constexpr (n == 12) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11); }
+			else if constexpr (n == 13) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12); }
+			else if constexpr (n == 14) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13); }
+			else if constexpr (n == 15) { const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14); }
+			else { static_assert(n == 16, "wy::aggregate_hash: up to 16 fields, declare 'wy_fields' for others"); const auto& [f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15] = obj; return f(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15); }
+		}
+	}
+
+	/// <summary>
+	/// Hasher of aggregates (structs without constructors) that never reads their padding.
+	/// Types without padding are hashed as bytes, like wy::hash. Others combine their fields without temporary buffers,
+	/// giving the same hash as wy::hash of the std::tuple of the fields. Nested aggregates with padding are walked the same way.
+	/// NOTE: Fields are found with structured bindings: C arrays fields and fields on base classes need 'wy_fields'.
+	/// </summary>
+	/// <typeparam name="T">The aggregate type</typeparam>
+	template<class T> struct aggregate_hash : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+
+		forceinline uint64_t operator()(const T& elem) const noexcept
+		{
+			if constexpr (internal::has_field_list<T>::value)
+				return internal::hash_tuple_fields(*this, wy_fields(elem));
+			else if constexpr (std::has_unique_object_representations_v<T>)
+				return wy::hash<T>(secret)(elem);// memcpy speed: no padding to skip
+			else
+			{
+				static_assert(std::is_aggregate_v<T>, "wy::aggregate_hash: the type is not an aggregate, declare 'wy_fields'");
+				return internal::visit_fields(elem, [this](const auto&... fields) {
+					uint64_t h = secret[0];
+					((h = combine(h, internal::field_bits(*this, fields))), ...);// Nested aggregates with padding are walked too
+					return h;
+				});
+			}
+		}
+	};
+
+	namespace internal {
+		// Elements hashed by their bytes: no padding or several representations of the same value. Not floating point:
+		// -0.0 == +0.0 with other bytes, and long double has padding
+		template<class E> constexpr bool hash_as_bytes_v = std::has_unique_object_representations_v<E>;
+
+		/// <summary>
+		/// Hash contiguous elements: as bytes when possible, otherwise combining each element with 'field_bits': the wy::hash
+		/// of the element with the secret of 'hasher', or wy::aggregate_hash for aggregates with padding
+		/// </summary>
+		template<class E> forceinline uint64_t hash_elements(const hash_imp& hasher, const E* data, size_t size) noexcept
+		{
+			if constexpr (hash_as_bytes_v<E>)
+				return hasher.wyhash(reinterpret_cast<const uint8_t*>(data), size * sizeof(E));
+			else
+			{
+				uint64_t h = hasher.secret[0];
+				for (size_t i = 0; i < size; i++)
+					h = hasher.combine(h, field_bits(hasher, data[i]));
+				return hasher.combine(h, size);
+			}
+		}
+	}
+
+	// Partial specializations: std::vector
+	template<class T> struct hash<std::vector<T>> :private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const std::vector<T>& elem) const noexcept
+		{
+			return internal::hash_elements(*this, elem.data(), elem.size());
+		}
+	};
+
+#if __cpp_lib_ranges
+	namespace internal {
+		template<class T> struct is_std_vector : std::false_type {};
+		template<class E, class A> struct is_std_vector<std::vector<E, A>> : std::true_type {};
+		template<class T> struct is_std_array : std::false_type {};
+		template<class E, size_t N> struct is_std_array<std::array<E, N>> : std::true_type {};
+
+		// Ranges hashed by their elements. Excluded: unordered containers (iteration order is not defined), ranges of
+		// themselves (std::filesystem::path), C arrays (on the fixed size path), and std::vector
+		template<class T> concept hashable_range = std::ranges::input_range<const T> && !std::is_array_v<T> &&
+			!std::is_same_v<std::ranges::range_value_t<T>, T> && !requires { typename T::hasher; } && !is_std_vector<T>::value;
+	}
+
+	/// <summary>
+	/// Partial specialization for ranges: std::span, std::deque, std::list, std::map, strings with custom traits, ...
+	/// Contiguous ranges are hashed in place, non-contiguous ranges are streamed. Both give the same hash for the same elements,
+	/// also with std::vector and std::array. C arrays are hashed by the primary wy::hash as other fixed size types, so
+	/// a C array of 4, 8 or 16 bytes differs from a std::span over it.
+	/// Views that can only be iterated as non-const (std::views::filter, drop_while...) don't compile: copy their elements first.
+	/// </summary>
+	/// <typeparam name="T">Type of the range</typeparam>
+	template<class T> requires internal::hashable_range<T> struct hash<T> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const T& range) const noexcept
+		{
+			using E = std::ranges::range_value_t<T>;
+			if constexpr (internal::is_std_array<T>::value && internal::hash_as_bytes_v<E>)
+				return hash_imp::wyhash_fixed<sizeof(T)>(reinterpret_cast<const uint8_t*>(range.data()));// The same as wyhash(data, size), unrolled
+			else if constexpr (std::ranges::contiguous_range<const T> && std::ranges::sized_range<const T>)
+				return internal::hash_elements(*this, std::ranges::data(range), static_cast<size_t>(std::ranges::size(range)));
+			else if constexpr (internal::hash_as_bytes_v<E>)
+			{
+				// Streaming: the elements are copied by blocks to feed hash_stream
+				hash_stream stream(secret);
+				uint8_t buffer[256];
+				size_t used = 0;
+				for (const E& elem : range)
+				{
+					if constexpr (sizeof(E) > sizeof(buffer))
+						stream.update(reinterpret_cast<const uint8_t*>(&elem), sizeof(E));
+					else
+					{
+						if (used + sizeof(E) > sizeof(buffer)) { stream.update(buffer, used); used = 0; }
+						memcpy(buffer + used, &elem, sizeof(E));
+						used += sizeof(E);
+					}
+				}
+				stream.update(buffer, used);
+				return stream.finish();
+			}
+			else
+			{
+				uint64_t h = secret[0];
+				size_t size = 0;
+				for (const E& elem : range) { h = combine(h, internal::field_bits(*this, elem)); size++; }
+				return combine(h, size);
+			}
+		}
+	};
+#endif
+
+	// C strings
+	template<> struct hash<char*> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const char* data) const noexcept
+		{
+			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+		}
+	};
+	template<> struct hash<const char*> : private internal::hash_imp
+	{
+		using hash_imp::hash_imp;// Inherit constructors
+		forceinline uint64_t operator()(const char* data) const noexcept
+		{
+			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+		}
+	};
+
+	// Partial specializations: std::string variants
+	template<> struct hash<std::string> : public internal::hash_string_base<std::string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::wstring> : public internal::hash_string_base<std::wstring>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::u16string> : public internal::hash_string_base<std::u16string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::u32string> : public internal::hash_string_base<std::u32string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	
+	// std::string_view variants
+#if __cpp_lib_string_view
+	template<> struct hash<std::string_view> : public internal::hash_string_base<std::string_view>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::wstring_view> : public internal::hash_string_base<std::wstring_view>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::u16string_view> : public internal::hash_string_base<std::u16string_view>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::u32string_view> : public internal::hash_string_base<std::u32string_view>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+#endif
+
+	// std::pmr::string variants
+#if __cpp_lib_polymorphic_allocator
+	template<> struct hash<std::pmr::string> : public internal::hash_string_base<std::pmr::string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::pmr::wstring> : public internal::hash_string_base<std::pmr::wstring>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::pmr::u16string> : public internal::hash_string_base<std::pmr::u16string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::pmr::u32string> : public internal::hash_string_base<std::pmr::u32string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+#endif
+
+	// char8_t string variants
+#if __cpp_char8_t
+	template<> struct hash<std::u8string> : public internal::hash_string_base<std::u8string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::u8string_view> : public internal::hash_string_base<std::u8string_view>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+	template<> struct hash<std::pmr::u8string> : public internal::hash_string_base<std::pmr::u8string>
+	{
+		using hash_string_base::hash_string_base;// Inherit constructors
+	};
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Compile-time hashing
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#if __cpp_lib_string_view
+	namespace internal {
+		// constexpr 128bit multiply: the portable decomposition gives the same bits as the '__uint128_t'/'_umul128' paths
+		constexpr void _wymum_ct(uint64_t& A, uint64_t& B) noexcept
+		{
+#if WYHASH_32BIT_MUM
+			uint64_t hh = (A >> 32) * (B >> 32), hl = (A >> 32) * (uint32_t)B, lh = (uint32_t)A * (B >> 32), ll = (uint64_t)(uint32_t)A * (uint32_t)B;
+			uint64_t lo = ((hl >> 32) | (hl << 32)) ^ hh, hi = ((lh >> 32) | (lh << 32)) ^ ll;
+#else
+			uint64_t ha = A >> 32, hb = B >> 32, la = (uint32_t)A, lb = (uint32_t)B;
+			uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+			uint64_t lo = t + (rm1 << 32); c += lo < t;
+			uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+#if WYHASH_CONDOM > 1
+			A ^= lo;  B ^= hi;
+#else
+			A = lo;  B = hi;
+#endif
+		}
+		constexpr uint64_t _wymix_ct(uint64_t A, uint64_t B) noexcept { _wymum_ct(A, B); return A ^ B; }
+
+		// constexpr read functions: always little endian, like '_wyr8'/'_wyr4' on any platform
+		constexpr uint64_t _wyr_ct(const char* p, size_t bytes) noexcept
+		{
+			uint64_t v = 0;
+			for (size_t i = 0; i < bytes; i++)
+				v |= uint64_t(uint8_t(p[i])) << (8 * i);
+			return v;
+		}
+		constexpr uint64_t _wyr8_ct(const char* p) noexcept { return _wyr_ct(p, 8); }
+		constexpr uint64_t _wyr4_ct(const char* p) noexcept { return _wyr_ct(p, 4); }
+		constexpr uint64_t _wyr3_ct(const char* p, size_t k) noexcept { return (uint64_t(uint8_t(p[0])) << 16) | (uint64_t(uint8_t(p[k >> 1])) << 8) | uint8_t(p[k - 1]); }
+
+		// constexpr version of 'hash_imp::wyhash'
+		constexpr uint64_t wyhash_ct(const char* p, size_t len, const uint64_t* secret) noexcept
+		{
+			uint64_t seed = secret[0], a = 0, b = 0;
+			if (len <= 16) {
+				if (len >= 4) { a = (_wyr4_ct(p) << 32) | _wyr4_ct(p + ((len >> 3) << 2)); b = (_wyr4_ct(p + len - 4) << 32) | _wyr4_ct(p + len - 4 - ((len >> 3) << 2)); }
+				else if (len > 0) { a = _wyr3_ct(p, len); b = 0; }
+			}
+			else {
+				size_t i = len;
+				if (i > 48) {
+					uint64_t see1 = seed, see2 = seed;
+					do {
+						seed = _wymix_ct(_wyr8_ct(p) ^ secret[1], _wyr8_ct(p + 8) ^ seed);
+						see1 = _wymix_ct(_wyr8_ct(p + 16) ^ secret[2], _wyr8_ct(p + 24) ^ see1);
+						see2 = _wymix_ct(_wyr8_ct(p + 32) ^ secret[3], _wyr8_ct(p + 40) ^ see2);
+						p += 48; i -= 48;
+					} while (i > 48);
+					seed ^= see1 ^ see2;
+				}
+				while (i > 16) { seed = _wymix_ct(_wyr8_ct(p) ^ secret[1], _wyr8_ct(p + 8) ^ seed);  i -= 16; p += 16; }
+				a = _wyr8_ct(p + i - 16);  b = _wyr8_ct(p + i - 8);
+			}
+			return _wymix_ct(secret[1] ^ len, _wymix_ct(a ^ secret[1], b ^ seed));
+		}
+	}
+
+	/// <summary>
+	/// Hash a string at compile time, for switch cases or static lookup tables.
+	/// The result is the same as 'wy::hash&lt;std::string&gt;()' (and string_view, C-strings) with the default secret.
+	/// </summary>
+	/// <param name="key">The string to hash</param>
+	/// <returns>A 64-bits hash</returns>
+	constexpr uint64_t hash_ct(std::string_view key) noexcept
+	{
+		return internal::wyhash_ct(key.data(), key.size(), internal::default_secret);
+	}
+
+	namespace literals {
+		/// <summary>
+		/// Compile-time hash of a string literal: 'switch (wy::hash&lt;std::string&gt;()(s)) { case "key"_wyh: ... }'
+		/// </summary>
+		constexpr uint64_t operator""_wyh(const char* key, size_t len) noexcept
+		{
+			return internal::wyhash_ct(key, len, internal::default_secret);
+		}
+	}
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// File hashing
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#if WY_FILE_HASHING
+	namespace internal {
+		/// <summary>
+		/// Read-only memory mapping of a whole file
+		/// </summary>
+		struct mapped_file
+		{
+			const uint8_t* data = nullptr;// The file content
+			size_t size = 0;// The size of the file
+			bool is_open = false;// True if the file was mapped successfully
+
+			/// <summary>
+			/// Map a file in memory
+			/// </summary>
+			/// <param name="path">The path of the file</param>
+			mapped_file(const std::filesystem::path& path) noexcept
+			{
+#ifdef _WIN32
+				file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+				if (file == INVALID_HANDLE_VALUE) return;
+				LARGE_INTEGER file_size;
+				if (!GetFileSizeEx(file, &file_size)) return;
+				size = static_cast<size_t>(file_size.QuadPart);
+				if (size == 0) { is_open = true; return; }// Empty files can't be mapped
+
+				mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (!mapping) return;
+				data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+				is_open = data != nullptr;
+#else
+				fd = open(path.c_str(), O_RDONLY);
+				if (fd < 0) return;
+				struct stat st;
+				if (fstat(fd, &st) != 0) return;
+				size = static_cast<size_t>(st.st_size);
+				if (size == 0) { is_open = true; return; }// Empty files can't be mapped
+
+				void* ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr == MAP_FAILED) return;
+				madvise(ptr, size, MADV_SEQUENTIAL);
+				data = static_cast<const uint8_t*>(ptr);
+				is_open = true;
+#endif
+			}
+			~mapped_file() noexcept
+			{
+#ifdef _WIN32
+				if (data) UnmapViewOfFile(data);
+				if (mapping) CloseHandle(mapping);
+				if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+				if (data) munmap(const_cast<uint8_t*>(data), size);
+				if (fd >= 0) close(fd);
+#endif
+			}
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+
+		private:
+#ifdef _WIN32
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#else
+			int fd = -1;
+#endif
+		};
+	}
+#endif
+
+	/// <summary>
+	/// Hash data in tree mode: fixed-size chunks are hashed in parallel and the chunk hashes are combined with 'wyhash64'.
+	/// NOTE: The digest is different from the linear 'wyhash' of the data and depends on 'chunk_size',
+	///       but not on the number of threads used.
+	/// </summary>
+	/// <param name="data">The data to hash</param>
+	/// <param name="len">The size of the data</param>
+	/// <param name="chunk_size">The size of the chunks hashed independently</param>
+	/// <param name="num_threads">The number of threads to use. 0 to use all hardware threads. Only with 'WY_THREADS' 1</param>
+	/// <param name="hasher">The hasher with the secret to use</param>
+	/// <returns>A 64-bits hash</returns>
+	inline uint64_t hash_tree(const uint8_t* data, size_t len, size_t chunk_size = 1 << 22, unsigned num_threads = 0, const internal::hash_imp& hasher = internal::hash_imp()) noexcept
+	{
+		assert(chunk_size > 0);
+
+		size_t num_chunks = (len + chunk_size - 1) / chunk_size;
+		std::vector<uint64_t> chunk_hashes(num_chunks);
+
+		// Hash the chunks
+		std::atomic<size_t> next_chunk = 0;
+		auto worker = [&]() noexcept {
+			for (size_t i = next_chunk++; i < num_chunks; i = next_chunk++)
+			{
+				size_t offset = i * chunk_size;
+				chunk_hashes[i] = hasher.wyhash(data + offset, len - offset < chunk_size ? len - offset : chunk_size);
+			}
+		};
+#if WY_THREADS
+		num_threads = internal::num_threads_to_use(num_threads);
+		if (num_threads > num_chunks) num_threads = static_cast<unsigned>(num_chunks);
+
+		std::vector<std::thread> threads;
+		for (unsigned i = 1; i < num_threads; i++)
+		{
+			try { threads.emplace_back(worker); }
+			catch (...) { break; }// The current thread hashes the chunks left
+		}
+		worker();
+		for (auto& t : threads)
+			t.join();
+#else
+		(void)num_threads;// The digest doesn't depend on the threads
+		worker();
+#endif
+
+		// Combine the chunk hashes
+		uint64_t result = hasher.wyhash(static_cast<uint64_t>(len));
+		for (uint64_t chunk_hash : chunk_hashes)
+			result = internal::wyhash64(result, chunk_hash);
+
+		return result;
+	}
+
+#if WY_FILE_HASHING
+	/// <summary>
+	/// Hash a file, mapping it in memory. Gives the same digest as hashing the file content with 'wyhash'.
+	/// </summary>
+	/// <param name="path">The path of the file</param>
+	/// <param name="hasher">The hasher with the secret to use</param>
+	/// <returns>A 64-bits hash, or empty if the file can't be read</returns>
+	inline std::optional<uint64_t> hash_file(const std::filesystem::path& path, const internal::hash_imp& hasher = internal::hash_imp()) noexcept
+	{
+		internal::mapped_file file(path);
+		if (!file.is_open) return std::nullopt;
+
+		return hasher.wyhash(file.data, file.size);
+	}
+
+	/// <summary>
+	/// Hash a file in tree mode, mapping it in memory. Gives the same digest as 'hash_tree' of the file content.
+	/// NOTE: The digest is different from the linear 'hash_file(path)'.
+	/// </summary>
+	/// <param name="path">The path of the file</param>
+	/// <param name="chunk_size">The size of the chunks hashed independently</param>
+	/// <param name="num_threads">The number of threads to use. 0 to use all hardware threads</param>
+	/// <param name="hasher">The hasher with the secret to use</param>
+	/// <returns>A 64-bits hash, or empty if the file can't be read</returns>
+	inline std::optional<uint64_t> hash_file_tree(const std::filesystem::path& path, size_t chunk_size = 1 << 22, unsigned num_threads = 0, const internal::hash_imp& hasher = internal::hash_imp()) noexcept
+	{
+		internal::mapped_file file(path);
+		if (!file.is_open) return std::nullopt;
+
+		return hash_tree(file.data, file.size, chunk_size, num_threads, hasher);
+	}
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Range reduction
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// All bits of a wyhash are well mixed, but a table must not use the same bits twice: 'reduce' depends on the high bits
+	// and 'pow2_index' on the low bits. The wy containers take the group index from the low bits and a 7-bits tag from the
+	// top 7 bits, so custom tables over them should index with the low bits and 'reduce' pairs with tags from the low bits.
+
+	/// <summary>
+	/// Map a hash to [0, n) with one multiply, not a division. Not 'hash % n' but as uniform: uses the high bits of the hash.
+	/// </summary>
+	/// <param name="hash">The hash value</param>
+	/// <param name="n">The number of buckets</param>
+	/// <returns>The bucket index</returns>
+	forceinline uint64_t reduce(uint64_t hash, uint64_t n) noexcept
+	{
+		return internal::_wymulhi(hash, n);
+	}
+
+	/// <summary>
+	/// Check if a number is a power of two
+	/// </summary>
+	constexpr bool is_pow2(uint64_t n) noexcept
+	{
+		return n && (n & (n - 1)) == 0;
+	}
+	/// <summary>
+	/// The smallest power of two greater or equal to 'n' (1 for 0), with 'n' at most 2^63
+	/// </summary>
+	constexpr uint64_t next_pow2(uint64_t n) noexcept
+	{
+		uint64_t result = 1;
+		while (result < n) result *= 2;
+		return result;
+	}
+	/// <summary>
+	/// Map a hash to [0, pow2_n) with a mask: uses the low bits of the hash
+	/// </summary>
+	/// <param name="hash">The hash value</param>
+	/// <param name="pow2_n">The number of buckets, a power of two</param>
+	/// <returns>The bucket index</returns>
+	constexpr uint64_t pow2_index(uint64_t hash, uint64_t pow2_n) noexcept
+	{
+		assert(is_pow2(pow2_n));
+		return hash & (pow2_n - 1);
+	}
+
+	/// <summary>
+	/// Exact 'a % divisor' without a division (Lemire, Kaser & Kurz). The magic number is precomputed for a fixed divisor,
+	/// then each modulo takes 4 multiplies. Use it where the result must be the real modulo, else 'reduce' is cheaper.
+	/// </summary>
+	class fastmod
+	{
+	public:
+		/// <summary>
+		/// Precompute the magic number of a divisor
+		/// </summary>
+		/// <param name="pdivisor">The divisor, not 0</param>
+		explicit fastmod(uint64_t pdivisor) : d(pdivisor)
+		{
+			if (pdivisor == 0)
+				throw std::invalid_argument("fastmod: divisor can't be 0");
+
+			// M = floor((2^128 - 1) / d) + 1, as a long division of 2 words
+			uint64_t rem = UINT64_MAX % d;
+			m_hi = UINT64_MAX / d;
+			m_lo = 0;
+			for (int i = 63; i >= 0; i--)
+			{
+				bool overflow = rem >> 63;
+				rem = (rem << 1) | 1;
+				m_lo <<= 1;
+				if (overflow || rem >= d) { rem -= d; m_lo |= 1; }
+			}
+			m_lo++;
+			m_hi += m_lo == 0;
+		}
+
+		/// <summary>
+		/// The remainder of the division
+		/// </summary>
+		/// <param name="a">The dividend</param>
+		/// <returns>'a % divisor()'</returns>
+		forceinline uint64_t operator()(uint64_t a) const noexcept
+		{
+			// lowbits = M * a mod 2^128, then the result are the high 64 bits of lowbits * d >> 128
+			uint64_t low_lo = m_lo * a;
+			uint64_t low_hi = m_hi * a + internal::_wymulhi(m_lo, a);
+			uint64_t middle = low_hi * d;
+			uint64_t sum = middle + internal::_wymulhi(low_lo, d);
+			return internal::_wymulhi(low_hi, d) + (sum < middle);
+		}
+		/// <summary>
+		/// The divisor
+		/// </summary>
+		uint64_t divisor() const noexcept { return d; }
+
+	private:
+		uint64_t m_lo, m_hi;
+		uint64_t d;
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Hash containers
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	namespace internal {
+		static constexpr size_t prefetch_min_bytes = 1 << 20;// Smaller tables are mostly on cache: prefetching only adds overhead
+
+		// Control bytes of the open-addressing tables.
+		// Full slots store the top 7 bits of the hash: 0b0xxxxxxx
+		static constexpr int8_t ctrl_empty = -128;   // 0b10000000
+		static constexpr int8_t ctrl_deleted = -2;   // 0b11111110
+		static constexpr int8_t ctrl_sentinel = -1;  // 0b11111111 Mark the end of the table for iterators
+
+		// Count trailing zeros, x != 0
+		static forceinline uint32_t _wyctz(uint64_t x) noexcept
+		{
+#if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__clang__)
+			return static_cast<uint32_t>(__builtin_ctzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long index;
+			_BitScanForward64(&index, x);
+			return index;
+#else
+			uint32_t count = 0;
+			while (!(x & 1)) { x >>= 1; count++; }
+			return count;
+#endif
+		}
+		// Count leading zeros, x != 0
+		static forceinline uint32_t _wyclz(uint64_t x) noexcept
+		{
+#if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__clang__)
+			return static_cast<uint32_t>(__builtin_clzll(x));
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long index;
+			_BitScanReverse64(&index, x);
+			return 63 - index;
+#else
+			uint32_t count = 0;
+			while (!(x & 0x8000000000000000ull)) { x <<= 1; count++; }
+			return count;
+#endif
+		}
+
+		/// <summary>
+		/// The slots of a group that match a condition
+		/// </summary>
+		struct group_mask
+		{
+			uint64_t mask;
+#if WY_HAS_NEON
+			static constexpr uint32_t shift = 2;// 4 bits by slot
+#else
+			static constexpr uint32_t shift = 0;// 1 bit by slot
+#endif
+			explicit operator bool() const noexcept { return mask != 0; }
+			uint32_t lowest() const noexcept { return _wyctz(mask) >> shift; }
+			void clear_lowest() noexcept { mask &= mask - 1; }
+		};
+
+		/// <summary>
+		/// A group of 16 control bytes probed at the same time
+		/// </summary>
+		struct group
+		{
+			static constexpr size_t size = 16;
+
+#if WY_HAS_SSE2
+			__m128i ctrl;
+			explicit group(const int8_t* p) noexcept : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+			group_mask match(int8_t h7) const noexcept { return { static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h7), ctrl))) }; }
+			group_mask match_empty() const noexcept { return match(ctrl_empty); }
+			group_mask match_empty_or_deleted() const noexcept { return { static_cast<uint32_t>(_mm_movemask_epi8(ctrl)) }; }// Only the high bit set
+#elif WY_HAS_NEON
+			int8x16_t ctrl;
+			explicit group(const int8_t* p) noexcept : ctrl(vld1q_s8(p)) {}
+
+			static forceinline group_mask to_mask(uint8x16_t cmp) noexcept
+			{
+				// Narrow each byte to 4 bits and keep one of them
+				uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+				return { vget_lane_u64(vreinterpret_u64_u8(narrow), 0) & 0x8888888888888888ull };
+			}
+			group_mask match(int8_t h7) const noexcept { return to_mask(vceqq_s8(vdupq_n_s8(h7), ctrl)); }
+			group_mask match_empty() const noexcept { return match(ctrl_empty); }
+			group_mask match_empty_or_deleted() const noexcept { return to_mask(vcltq_s8(ctrl, vdupq_n_s8(ctrl_sentinel))); }
+#else
+			int8_t ctrl[size];
+			explicit group(const int8_t* p) noexcept { memcpy(ctrl, p, size); }
+
+			group_mask match(int8_t h7) const noexcept
+			{
+				uint64_t mask = 0;
+				for (size_t i = 0; i < size; i++)
+					mask |= static_cast<uint64_t>(ctrl[i] == h7) << i;
+				return { mask };
+			}
+			group_mask match_empty() const noexcept { return match(ctrl_empty); }
+			group_mask match_empty_or_deleted() const noexcept
+			{
+				uint64_t mask = 0;
+				for (size_t i = 0; i < size; i++)
+					mask |= static_cast<uint64_t>(ctrl[i] < ctrl_sentinel) << i;
+				return { mask };
+			}
+#endif
+		};
+
+		template<class T, class = void> struct is_transparent : std::false_type {};
+		template<class T> struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
+		/// <summary>
+		/// Open-addressing hash table with SIMD metadata probing.
+		/// Slots are stored contiguously and probed by groups of 16 control bytes. The top 7 bits of the 64-bit hash are
+		/// stored on the control byte of the slot and the low bits select the first group to probe.
+		/// </summary>
+		/// <typeparam name="KEY">The type of the keys</typeparam>
+		/// <typeparam name="VALUE">The type stored on the slots</typeparam>
+		/// <typeparam name="GET_KEY">Functor to get the key from a value</typeparam>
+		/// <typeparam name="HASH">The hash function</typeparam>
+		/// <typeparam name="KEY_EQUAL">The key comparison function</typeparam>
+		/// <typeparam name="ALLOCATOR">The allocator</typeparam>
+		template<class KEY, class VALUE, class GET_KEY, class HASH, class KEY_EQUAL, class ALLOCATOR> class flat_table
+		{
+		public:
+			using key_type = KEY;
+			using value_type = VALUE;
+			using size_type = size_t;
+			using difference_type = std::ptrdiff_t;
+			using hasher = HASH;
+			using key_equal = KEY_EQUAL;
+			using allocator_type = ALLOCATOR;
+			using reference = value_type&;
+			using const_reference = const value_type&;
+
+			/// <summary>
+			/// Forward iterator over the full slots
+			/// </summary>
+			template<bool IS_CONST> class iterator_base
+			{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = VALUE;
+				using difference_type = std::ptrdiff_t;
+				using pointer = std::conditional_t<IS_CONST, const VALUE*, VALUE*>;
+				using reference = std::conditional_t<IS_CONST, const VALUE&, VALUE&>;
+
+				iterator_base() noexcept = default;
+				template<bool OTHER_CONST, class = std::enable_if_t<IS_CONST && !OTHER_CONST>>
+				iterator_base(const iterator_base<OTHER_CONST>& other) noexcept : ctrl(other.ctrl), slot(other.slot) {}
+
+				reference operator*() const noexcept { return *slot; }
+				pointer operator->() const noexcept { return slot; }
+				iterator_base& operator++() noexcept { ++ctrl; ++slot; skip_free(); return *this; }
+				iterator_base operator++(int) noexcept { iterator_base tmp = *this; ++*this; return tmp; }
+				friend bool operator==(const iterator_base& a, const iterator_base& b) noexcept { return a.ctrl == b.ctrl; }
+				friend bool operator!=(const iterator_base& a, const iterator_base& b) noexcept { return a.ctrl != b.ctrl; }
+
+			private:
+				friend class flat_table;
+				template<bool> friend class iterator_base;
+
+				const int8_t* ctrl = nullptr;
+				pointer slot = nullptr;
+
+				iterator_base(const int8_t* pctrl, pointer pslot) noexcept : ctrl(pctrl), slot(pslot) {}
+				void skip_free() noexcept { while (*ctrl < ctrl_sentinel) { ++ctrl; ++slot; } }
+			};
+			using iterator = iterator_base<false>;
+			using const_iterator = iterator_base<true>;
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Construction
+			////////////////////////////////////////////////////////////////////////////////////
+			flat_table() noexcept : flat_table(0) {}
+			explicit flat_table(size_t bucket_count, const HASH& phash = HASH(), const KEY_EQUAL& pequal = KEY_EQUAL(), const ALLOCATOR& palloc = ALLOCATOR())
+				: hash_function_(phash), key_eq_(pequal), alloc(palloc)
+			{
+				if (bucket_count) rehash(bucket_count);
+			}
+			explicit flat_table(const ALLOCATOR& palloc) : flat_table(0, HASH(), KEY_EQUAL(), palloc) {}
+			template<class INPUT_IT> flat_table(INPUT_IT first, INPUT_IT last, size_t bucket_count = 0, const HASH& phash = HASH(), const KEY_EQUAL& pequal = KEY_EQUAL(), const ALLOCATOR& palloc = ALLOCATOR())
+				: flat_table(bucket_count, phash, pequal, palloc)
+			{
+				insert(first, last);
+			}
+			flat_table(std::initializer_list<VALUE> init, size_t bucket_count = 0, const HASH& phash = HASH(), const KEY_EQUAL& pequal = KEY_EQUAL(), const ALLOCATOR& palloc = ALLOCATOR())
+				: flat_table(init.begin(), init.end(), bucket_count, phash, pequal, palloc)
+			{}
+			flat_table(const flat_table& other)
+				: flat_table(0, other.hash_function_, other.key_eq_, std::allocator_traits<value_allocator>::select_on_container_copy_construction(other.alloc))
+			{
+				copy_from(other);
+			}
+			flat_table(const flat_table& other, const ALLOCATOR& palloc) : flat_table(0, other.hash_function_, other.key_eq_, palloc)
+			{
+				copy_from(other);
+			}
+			flat_table(flat_table&& other) noexcept
+				: hash_function_(std::move(other.hash_function_)), key_eq_(std::move(other.key_eq_)), alloc(std::move(other.alloc))
+			{
+				steal(other);
+			}
+			flat_table(flat_table&& other, const ALLOCATOR& palloc) : flat_table(0, other.hash_function_, other.key_eq_, palloc)
+			{
+				if (alloc == other.alloc)
+					steal(other);
+				else
+					move_elements_from(other);
+			}
+			~flat_table() noexcept
+			{
+				destroy();
+			}
+
+			flat_table& operator=(const flat_table& other)
+			{
+				if (this != &other)
+				{
+					clear();
+					if constexpr (std::allocator_traits<value_allocator>::propagate_on_container_copy_assignment::value)
+					{
+						if (alloc != other.alloc) { destroy(); reset_empty(); }
+						alloc = other.alloc;
+					}
+					hash_function_ = other.hash_function_;
+					key_eq_ = other.key_eq_;
+					copy_from(other);
+				}
+				return *this;
+			}
+			flat_table& operator=(flat_table&& other) noexcept(std::allocator_traits<value_allocator>::is_always_equal::value || std::allocator_traits<value_allocator>::propagate_on_container_move_assignment::value)
+			{
+				if (this != &other)
+				{
+					hash_function_ = std::move(other.hash_function_);
+					key_eq_ = std::move(other.key_eq_);
+					if (std::allocator_traits<value_allocator>::propagate_on_container_move_assignment::value || alloc == other.alloc)
+					{
+						destroy();
+						if constexpr (std::allocator_traits<value_allocator>::propagate_on_container_move_assignment::value)
+							alloc = std::move(other.alloc);
+						steal(other);
+					}
+					else
+					{
+						clear();
+						move_elements_from(other);
+					}
+				}
+				return *this;
+			}
+			flat_table& operator=(std::initializer_list<VALUE> init)
+			{
+				clear();
+				insert(init.begin(), init.end());
+				return *this;
+			}
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Iterators
+			////////////////////////////////////////////////////////////////////////////////////
+			iterator begin() noexcept { if (!capacity_) return end(); iterator it(ctrl, slots); it.skip_free(); return it; }
+			const_iterator begin() const noexcept { if (!capacity_) return end(); const_iterator it(ctrl, slots); it.skip_free(); return it; }
+			const_iterator cbegin() const noexcept { return begin(); }
+			iterator end() noexcept { return iterator(ctrl + capacity_, slots + capacity_); }
+			const_iterator end() const noexcept { return const_iterator(ctrl + capacity_, slots + capacity_); }
+			const_iterator cend() const noexcept { return end(); }
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Capacity
+			////////////////////////////////////////////////////////////////////////////////////
+			bool empty() const noexcept { return size_ == 0; }
+			size_t size() const noexcept { return size_; }
+			size_t max_size() const noexcept { return std::allocator_traits<value_allocator>::max_size(alloc); }
+			size_t bucket_count() const noexcept { return capacity_; }
+			float load_factor() const noexcept { return capacity_ ? static_cast<float>(size_) / static_cast<float>(capacity_) : 0.0f; }
+			static constexpr float max_load_factor() noexcept { return 0.875f; }
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Modifiers
+			////////////////////////////////////////////////////////////////////////////////////
+			void clear() noexcept
+			{
+				if (size_ == 0 && growth_left == capacity_ * 7 / 8) return;
+				for (size_t i = 0; i < capacity_; i++)
+				{
+					if (ctrl[i] >= 0) std::allocator_traits<value_allocator>::destroy(alloc, slots + i);
+					ctrl[i] = ctrl_empty;
+				}
+				size_ = 0;
+				growth_left = capacity_ * 7 / 8;
+			}
+
+			std::pair<iterator, bool> insert(const VALUE& value) { return emplace_key(GET_KEY()(value), value); }
+			std::pair<iterator, bool> insert(VALUE&& value) { return emplace_key(GET_KEY()(value), std::move(value)); }
+			template<class INPUT_IT> void insert(INPUT_IT first, INPUT_IT last)
+			{
+				for (; first != last; ++first)
+					insert(*first);
+			}
+			void insert(std::initializer_list<VALUE> init) { insert(init.begin(), init.end()); }
+			template<class... ARGS> std::pair<iterator, bool> emplace(ARGS&&... args)
+			{
+				VALUE value(std::forward<ARGS>(args)...);
+				return insert(std::move(value));
+			}
+
+			iterator erase(const_iterator pos) noexcept
+			{
+				size_t index = static_cast<size_t>(pos.ctrl - ctrl);
+				erase_index(index);
+				iterator next(ctrl + index, slots + index);
+				next.skip_free();
+				return next;
+			}
+			iterator erase(iterator pos) noexcept { return erase(const_iterator(pos)); }
+			size_t erase(const KEY& key) noexcept
+			{
+				size_t index = find_index(key, hash_key(key));
+				if (index == npos) return 0;
+				erase_index(index);
+				return 1;
+			}
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			size_t erase(const Q& key) noexcept
+			{
+				size_t index = find_index(key, hash_key(key));
+				if (index == npos) return 0;
+				erase_index(index);
+				return 1;
+			}
+
+			void swap(flat_table& other) noexcept
+			{
+				using std::swap;
+				swap(hash_function_, other.hash_function_);
+				swap(key_eq_, other.key_eq_);
+				if constexpr (std::allocator_traits<value_allocator>::propagate_on_container_swap::value)
+					swap(alloc, other.alloc);
+				swap(ctrl, other.ctrl);
+				swap(slots, other.slots);
+				swap(capacity_, other.capacity_);
+				swap(size_, other.size_);
+				swap(growth_left, other.growth_left);
+			}
+			friend void swap(flat_table& a, flat_table& b) noexcept { a.swap(b); }
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Lookup
+			////////////////////////////////////////////////////////////////////////////////////
+			iterator find(const KEY& key) noexcept { return to_iterator(find_index(key, hash_key(key))); }
+			const_iterator find(const KEY& key) const noexcept { return to_iterator(find_index(key, hash_key(key))); }
+			bool contains(const KEY& key) const noexcept { return find_index(key, hash_key(key)) != npos; }
+			size_t count(const KEY& key) const noexcept { return contains(key) ? 1 : 0; }
+
+			// Heterogeneous lookup, enabled when both the hash and the key comparison declare 'is_transparent'
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			iterator find(const Q& key) noexcept { return to_iterator(find_index(key, hash_key(key))); }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			const_iterator find(const Q& key) const noexcept { return to_iterator(find_index(key, hash_key(key))); }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			bool contains(const Q& key) const noexcept { return find_index(key, hash_key(key)) != npos; }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			size_t count(const Q& key) const noexcept { return contains(key) ? 1 : 0; }
+
+			// Lookup with a hash already computed with 'hash_function()', ex: to prefetch the slots before
+			iterator find(const KEY& key, uint64_t hash) noexcept { return to_iterator(find_index(key, hash)); }
+			const_iterator find(const KEY& key, uint64_t hash) const noexcept { return to_iterator(find_index(key, hash)); }
+			bool contains(const KEY& key, uint64_t hash) const noexcept { return find_index(key, hash) != npos; }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			iterator find(const Q& key, uint64_t hash) noexcept { return to_iterator(find_index(key, hash)); }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			const_iterator find(const Q& key, uint64_t hash) const noexcept { return to_iterator(find_index(key, hash)); }
+			template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<is_transparent<H>::value && is_transparent<E>::value>>
+			bool contains(const Q& key, uint64_t hash) const noexcept { return find_index(key, hash) != npos; }
 
 			/// <summary>
-			/// Create a wyhasher with default secret
-			/// </summary>
-			hash_imp() noexcept : secret{ 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull }// the default secret parameters
-			{}
-			/// <summary>
-			/// Create a wyhasher with secret generated from a seed
+			/// Bring to cache the control bytes and the first slots that a lookup of the hash reads
 			/// </summary>
-			/// <param name="seed">The seed to generate the secret from</param>
-			hash_imp(uint64_t seed) noexcept
+			/// <param name="hash">The hash of the key, from 'hash_function()'</param>
+			forceinline void prefetch(uint64_t hash) const noexcept
+			{
+				size_t g = static_cast<size_t>(hash) & group_index_mask();
+				internal::_wyprefetch(ctrl + g * group::size);
+				if (capacity_) internal::_wyprefetch(slots + g * group::size);
+			}
+			/// <summary>
+			/// Memory used by the control bytes and the slots
+			/// </summary>
+			size_t size_in_bytes() const noexcept { return capacity_ ? capacity_ * sizeof(VALUE) + capacity_ + 1 : 0; }
+			/// <summary>
+			/// Diagnostic of the load pattern: element [i] is the number of elements found on the i-th group probed,
+			/// 0 being the home group of the hash. Long tails mean clustered hashes. Rehashes all the keys.
+			/// </summary>
+			std::vector<size_t> probe_histogram() const
+			{
+				std::vector<size_t> histogram;
+				size_t mask = group_index_mask();
+				for (size_t i = 0; i < capacity_; i++)
+				{
+					if (ctrl[i] < 0) continue;
+					size_t g = static_cast<size_t>(hash_key(GET_KEY()(slots[i]))) & mask;
+					size_t probes = 0;
+					for (size_t step = 1; g != i / group::size; step++, probes++)
+						g = (g + step) & mask;
+					if (histogram.size() <= probes) histogram.resize(probes + 1);
+					histogram[probes]++;
+				}
+				return histogram;
+			}
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Hash policy
+			////////////////////////////////////////////////////////////////////////////////////
+			/// <summary>
+			/// Set the number of slots to the power of two needed to store at least 'count' elements
+			/// without exceeding the max_load_factor, or the current size if bigger
+			/// </summary>
+			void rehash(size_t count)
+			{
+				size_t needed = count > size_ ? count : size_;
+				if (needed == 0) { destroy(); reset_empty(); return; }
+
+				size_t new_capacity = group::size;
+				while (new_capacity * 7 / 8 < needed) new_capacity *= 2;
+				if (new_capacity != capacity_) resize(new_capacity);
+			}
+			void reserve(size_t count) { if (count > capacity_ * 7 / 8) rehash(count); }
+
+			////////////////////////////////////////////////////////////////////////////////////
+			// Observers
+			////////////////////////////////////////////////////////////////////////////////////
+			hasher hash_function() const { return hash_function_; }
+			key_equal key_eq() const { return key_eq_; }
+			allocator_type get_allocator() const noexcept { return allocator_type(alloc); }
+
+			friend bool operator==(const flat_table& a, const flat_table& b)
+			{
+				if (a.size() != b.size()) return false;
+				for (const VALUE& value : a)
+				{
+					size_t index = b.find_index(GET_KEY()(value), b.hash_key(GET_KEY()(value)));
+					if (index == npos || !(b.slots[index] == value)) return false;
+				}
+				return true;
+			}
+			friend bool operator!=(const flat_table& a, const flat_table& b) { return !(a == b); }
+
+		protected:
+			using value_allocator = typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<VALUE>;
+			using ctrl_allocator = typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<int8_t>;
+			static constexpr size_t npos = SIZE_MAX;
+
+			int8_t* ctrl = empty_ctrl();// 'capacity_' control bytes followed by a sentinel
+			VALUE* slots = nullptr;
+			size_t capacity_ = 0;// Always a power of two, or 0
+			size_t size_ = 0;
+			size_t growth_left = 0;// Number of empty slots that can be filled before a rehash
+			HASH hash_function_;
+			KEY_EQUAL key_eq_;
+			value_allocator alloc;
+
+			// Control bytes of tables without slots: lookups don't need to check for an empty table
+			static int8_t* empty_ctrl() noexcept
+			{
+				alignas(16) static int8_t empty[group::size + 1] = {
+					ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty,
+					ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_empty, ctrl_sentinel };
+				return empty;
+			}
+			template<class Q> forceinline uint64_t hash_key(const Q& key) const noexcept { return static_cast<uint64_t>(hash_function_(key)); }
+			static forceinline int8_t h7(uint64_t hash) noexcept { return static_cast<int8_t>(hash >> 57); }
+			forceinline size_t group_index_mask() const noexcept { return capacity_ ? capacity_ / group::size - 1 : 0; }
+
+			iterator to_iterator(size_t index) noexcept { return index == npos ? end() : iterator(ctrl + index, slots + index); }
+			const_iterator to_iterator(size_t index) const noexcept { return index == npos ? end() : const_iterator(ctrl + index, slots + index); }
+
+			/// <summary>
+			/// Find the slot of a key
+			/// </summary>
+			/// <returns>The index of the slot or 'npos' if not found</returns>
+			template<class Q> forceinline size_t find_index(const Q& key, uint64_t hash) const noexcept
+			{
+				size_t mask = group_index_mask();
+				size_t g = static_cast<size_t>(hash) & mask;
+				int8_t tag = h7(hash);
+				for (size_t step = 1;; step++)
+				{
+					group grp(ctrl + g * group::size);
+					for (group_mask m = grp.match(tag); m; m.clear_lowest())
+					{
+						size_t index = g * group::size + m.lowest();
+						if (key_eq_(key, GET_KEY()(slots[index]))) return index;
+					}
+					if (grp.match_empty()) return npos;
+					g = (g + step) & mask;// Triangular probing visits all groups
+				}
+			}
+			/// <summary>
+			/// Find the first empty or deleted slot in the probe sequence of a hash
+			/// </summary>
+			forceinline size_t find_free(uint64_t hash) const noexcept
+			{
+				size_t mask = group_index_mask();
+				size_t g = static_cast<size_t>(hash) & mask;
+				for (size_t step = 1;; step++)
+				{
+					group_mask m = group(ctrl + g * group::size).match_empty_or_deleted();
+					if (m) return g * group::size + m.lowest();
+					g = (g + step) & mask;
+				}
+			}
+
+			/// <summary>
+			/// Insert a value if the key is not present
+			/// </summary>
+			template<class Q, class... ARGS> std::pair<iterator, bool> emplace_key(const Q& key, ARGS&&... args)
+			{
+				return emplace_key_hashed(key, hash_key(key), std::forward<ARGS>(args)...);
+			}
+			template<class Q, class... ARGS> std::pair<iterator, bool> emplace_key_hashed(const Q& key, uint64_t hash, ARGS&&... args)
+			{
+				size_t index = find_index(key, hash);
+				if (index != npos) return { iterator(ctrl + index, slots + index), false };
+
+				index = find_free(hash);
+				if (_unlikely_(growth_left == 0 && ctrl[index] == ctrl_empty))
+				{
+					// Grow, or clean the deleted slots if many
+					resize(size_ + 1 > capacity_ * 7 / 16 ? (capacity_ ? capacity_ * 2 : group::size) : capacity_);
+					index = find_free(hash);
+				}
+				std::allocator_traits<value_allocator>::construct(alloc, slots + index, std::forward<ARGS>(args)...);
+				growth_left -= ctrl[index] == ctrl_empty;
+				ctrl[index] = h7(hash);
+				size_++;
+				return { iterator(ctrl + index, slots + index), true };
+			}
+
+			void erase_index(size_t index) noexcept
+			{
+				std::allocator_traits<value_allocator>::destroy(alloc, slots + index);
+				size_--;
+				// If the group has an empty slot no probe sequence continued after it, so the slot can be empty again
+				size_t group_start = index & ~(group::size - 1);
+				if (group(ctrl + group_start).match_empty())
+				{
+					ctrl[index] = ctrl_empty;
+					growth_left++;
+				}
+				else
+					ctrl[index] = ctrl_deleted;
+			}
+
+			void resize(size_t new_capacity)
+			{
+				int8_t* old_ctrl = ctrl;
+				VALUE* old_slots = slots;
+				size_t old_capacity = capacity_;
+
+				ctrl_allocator ctrl_alloc(alloc);
+				ctrl = std::allocator_traits<ctrl_allocator>::allocate(ctrl_alloc, new_capacity + 1);
+				try
+				{
+					slots = std::allocator_traits<value_allocator>::allocate(alloc, new_capacity);
+				}
+				catch (...)
+				{
+					std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc, ctrl, new_capacity + 1);
+					ctrl = old_ctrl;
+					throw;
+				}
+				memset(ctrl, static_cast<uint8_t>(ctrl_empty), new_capacity);
+				ctrl[new_capacity] = ctrl_sentinel;
+				capacity_ = new_capacity;
+				growth_left = new_capacity * 7 / 8 - size_;
+
+				// Move the elements
+				for (size_t i = 0; i < old_capacity; i++)
+					if (old_ctrl[i] >= 0)
+					{
+						uint64_t hash = hash_key(GET_KEY()(old_slots[i]));
+						size_t index = find_free(hash);
+						std::allocator_traits<value_allocator>::construct(alloc, slots + index, std::move(old_slots[i]));
+						std::allocator_traits<value_allocator>::destroy(alloc, old_slots + i);
+						ctrl[index] = h7(hash);
+					}
+
+				if (old_capacity)
+				{
+					std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc, old_ctrl, old_capacity + 1);
+					std::allocator_traits<value_allocator>::deallocate(alloc, old_slots, old_capacity);
+				}
+			}
+
+			void destroy() noexcept
+			{
+				if (!capacity_) return;
+				for (size_t i = 0; i < capacity_; i++)
+					if (ctrl[i] >= 0) std::allocator_traits<value_allocator>::destroy(alloc, slots + i);
+
+				ctrl_allocator ctrl_alloc(alloc);
+				std::allocator_traits<ctrl_allocator>::deallocate(ctrl_alloc, ctrl, capacity_ + 1);
+				std::allocator_traits<value_allocator>::deallocate(alloc, slots, capacity_);
+			}
+			void reset_empty() noexcept
+			{
+				ctrl = empty_ctrl();
+				slots = nullptr;
+				capacity_ = size_ = growth_left = 0;
+			}
+			void steal(flat_table& other) noexcept
+			{
+				ctrl = other.ctrl;
+				slots = other.slots;
+				capacity_ = other.capacity_;
+				size_ = other.size_;
+				growth_left = other.growth_left;
+				other.reset_empty();
+			}
+			void copy_from(const flat_table& other)
+			{
+				reserve(other.size_);
+				for (const VALUE& value : other)
+					insert(value);
+			}
+			void move_elements_from(flat_table& other)
+			{
+				reserve(other.size_);
+				for (VALUE& value : other)
+					insert(std::move(value));
+				other.clear();
+			}
+		};
+
+		// Key extraction for maps and sets
+		struct get_first { template<class PAIR> const auto& operator()(const PAIR& value) const noexcept { return value.first; } };
+		struct get_self { template<class T> const T& operator()(const T& value) const noexcept { return value; } };
+	}
+
+	/// <summary>
+	/// Cache-friendly hash map with open addressing and SIMD metadata probing, using wy::hash by default.
+	/// NOTE: Unlike std::unordered_map, the elements are stored as 'std::pair<KEY, VALUE>' and inserting may move them,
+	///       invalidating iterators and references. The key of an element must not be modified.
+	/// </summary>
+	/// <typeparam name="KEY">The type of the keys</typeparam>
+	/// <typeparam name="VALUE">The type of the mapped values</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	/// <typeparam name="KEY_EQUAL">The key comparison function</typeparam>
+	/// <typeparam name="ALLOCATOR">The allocator</typeparam>
+	template<class KEY, class VALUE, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>, class ALLOCATOR = std::allocator<std::pair<KEY, VALUE>>>
+	class flat_map : public internal::flat_table<KEY, std::pair<KEY, VALUE>, internal::get_first, HASH, KEY_EQUAL, ALLOCATOR>
+	{
+		using base = internal::flat_table<KEY, std::pair<KEY, VALUE>, internal::get_first, HASH, KEY_EQUAL, ALLOCATOR>;
+	public:
+		using mapped_type = VALUE;
+		using typename base::iterator;
+		using typename base::const_iterator;
+		using base::base;// Inherit constructors
+		using base::operator=;
+
+		/// <summary>
+		/// Insert an element constructed in-place if the key is not present
+		/// </summary>
+		template<class... ARGS> std::pair<iterator, bool> try_emplace(const KEY& key, ARGS&&... args)
+		{
+			return this->emplace_key(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<ARGS>(args)...));
+		}
+		template<class... ARGS> std::pair<iterator, bool> try_emplace(KEY&& key, ARGS&&... args)
+		{
+			return this->emplace_key(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+		}
+		/// <summary>
+		/// Insert an element or assign to the current one if the key is present
+		/// </summary>
+		template<class M> std::pair<iterator, bool> insert_or_assign(const KEY& key, M&& obj)
+		{
+			auto result = try_emplace(key, std::forward<M>(obj));
+			if (!result.second) result.first->second = std::forward<M>(obj);
+			return result;
+		}
+		template<class M> std::pair<iterator, bool> insert_or_assign(KEY&& key, M&& obj)
+		{
+			auto result = try_emplace(std::move(key), std::forward<M>(obj));
+			if (!result.second) result.first->second = std::forward<M>(obj);
+			return result;
+		}
+
+		VALUE& operator[](const KEY& key) { return try_emplace(key).first->second; }
+		VALUE& operator[](KEY&& key) { return try_emplace(std::move(key)).first->second; }
+
+		VALUE& at(const KEY& key)
+		{
+			auto it = this->find(key);
+			if (it == this->end()) throw std::out_of_range("wy::flat_map::at: key not found");
+			return it->second;
+		}
+		const VALUE& at(const KEY& key) const
+		{
+			auto it = this->find(key);
+			if (it == this->end()) throw std::out_of_range("wy::flat_map::at: key not found");
+			return it->second;
+		}
+	};
+
+	/// <summary>
+	/// Cache-friendly hash set with open addressing and SIMD metadata probing, using wy::hash by default.
+	/// NOTE: Unlike std::unordered_set, inserting may move the elements, invalidating iterators and references.
+	/// </summary>
+	/// <typeparam name="KEY">The type of the keys</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	/// <typeparam name="KEY_EQUAL">The key comparison function</typeparam>
+	/// <typeparam name="ALLOCATOR">The allocator</typeparam>
+	template<class KEY, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>, class ALLOCATOR = std::allocator<KEY>>
+	class flat_set : public internal::flat_table<KEY, KEY, internal::get_self, HASH, KEY_EQUAL, ALLOCATOR>
+	{
+		using base = internal::flat_table<KEY, KEY, internal::get_self, HASH, KEY_EQUAL, ALLOCATOR>;
+	public:
+		using iterator = typename base::const_iterator;// Elements of a set can't be modified
+		using typename base::const_iterator;
+		using base::base;// Inherit constructors
+		using base::operator=;
+		using base::insert;
+		using base::erase;
+
+		std::pair<const_iterator, bool> insert(const KEY& key) { auto result = base::insert(key); return { result.first, result.second }; }
+		std::pair<const_iterator, bool> insert(KEY&& key) { auto result = base::insert(std::move(key)); return { result.first, result.second }; }
+		template<class... ARGS> std::pair<const_iterator, bool> emplace(ARGS&&... args) { auto result = base::emplace(std::forward<ARGS>(args)...); return { result.first, result.second }; }
+
+		const_iterator begin() const noexcept { return base::begin(); }
+		const_iterator end() const noexcept { return base::end(); }
+		const_iterator find(const KEY& key) const noexcept { return base::find(key); }
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		const_iterator find(const Q& key) const noexcept { return base::find(key); }
+		const_iterator find(const KEY& key, uint64_t hash) const noexcept { return base::find(key, hash); }
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		const_iterator find(const Q& key, uint64_t hash) const noexcept { return base::find(key, hash); }
+	};
+
+#ifdef __cpp_lib_memory_resource
+	namespace pmr {
+		/// <summary>
+		/// wy::flat_map on a 'std::pmr::memory_resource'. Elements like 'std::pmr::string' use the resource of the map.
+		/// </summary>
+		template<class KEY, class VALUE, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>>
+		using flat_map = wy::flat_map<KEY, VALUE, HASH, KEY_EQUAL, std::pmr::polymorphic_allocator<std::pair<KEY, VALUE>>>;
+		/// <summary>
+		/// wy::flat_set on a 'std::pmr::memory_resource'. Elements like 'std::pmr::string' use the resource of the set.
+		/// </summary>
+		template<class KEY, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>>
+		using flat_set = wy::flat_set<KEY, HASH, KEY_EQUAL, std::pmr::polymorphic_allocator<KEY>>;
+	}
+#endif
+
+#ifdef __cpp_lib_span
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Batch lookup
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Lookups on a big table are one cache miss after another. The pipeline hashes a group of keys, prefetches their slots
+	// and then resolves them, so the misses of the group overlap. Works with the wy tables and, without prefetching, with
+	// any container with 'find' and 'hash_function()' like 'std::unordered_map'.
+	namespace internal {
+		template<class CONTAINER> using find_result_t = decltype(std::declval<CONTAINER&>().find(std::declval<const typename CONTAINER::key_type&>()));
+		template<class CONTAINER, class = void> struct has_prefetch : std::false_type {};
+		template<class CONTAINER> struct has_prefetch<CONTAINER, std::void_t<decltype(std::declval<const CONTAINER&>().prefetch(uint64_t()))>> : std::true_type {};
+	}
+
+	/// <summary>
+	/// Hash keys with the hash function of a container
+	/// </summary>
+	/// <param name="container">The container to look up</param>
+	/// <param name="keys">The keys</param>
+	/// <param name="hashes">out: The hash of each key</param>
+	template<class CONTAINER> void hash_all(const CONTAINER& container, std::span<const typename CONTAINER::key_type> keys, std::span<uint64_t> hashes) noexcept
+	{
+		assert(hashes.size() >= keys.size());
+		auto hasher = container.hash_function();
+		for (size_t i = 0; i < keys.size(); i++)
+			hashes[i] = static_cast<uint64_t>(hasher(keys[i]));
+	}
+	/// <summary>
+	/// Bring to cache the slots of hashes computed with 'hash_all'. Does nothing for containers without 'prefetch(hash)'
+	/// </summary>
+	/// <param name="container">The container to look up</param>
+	/// <param name="hashes">The hashes of the keys</param>
+	template<class CONTAINER> void prefetch(const CONTAINER& container, std::span<const uint64_t> hashes) noexcept
+	{
+		if constexpr (internal::has_prefetch<CONTAINER>::value)
+			for (uint64_t hash : hashes)
+				container.prefetch(hash);
+	}
+	/// <summary>
+	/// Find keys whose hashes were computed with 'hash_all'
+	/// </summary>
+	/// <param name="container">The container to look up</param>
+	/// <param name="keys">The keys</param>
+	/// <param name="hashes">The hashes of the keys</param>
+	/// <param name="out">out: The iterator to the element of each key, or 'container.end()'</param>
+	/// <returns>The number of keys found</returns>
+	template<class CONTAINER> size_t resolve(CONTAINER& container, std::span<const typename CONTAINER::key_type> keys, std::span<const uint64_t> hashes, std::span<internal::find_result_t<CONTAINER>> out) noexcept
+	{
+		assert(hashes.size() >= keys.size() && out.size() >= keys.size());
+		size_t num_found = 0;
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			if constexpr (internal::has_prefetch<CONTAINER>::value)
+				out[i] = container.find(keys[i], hashes[i]);
+			else
+				out[i] = container.find(keys[i]);
+			num_found += out[i] != container.end();
+		}
+		return num_found;
+	}
+	/// <summary>
+	/// Find many keys. The keys are hashed by groups and their slots prefetched to overlap the cache misses.
+	/// </summary>
+	/// <param name="container">The container to look up</param>
+	/// <param name="keys">The keys</param>
+	/// <param name="out">out: The iterator to the element of each key, or 'container.end()'</param>
+	/// <returns>The number of keys found</returns>
+	template<class CONTAINER> size_t batch_find(CONTAINER& container, std::span<const typename CONTAINER::key_type> keys, std::span<internal::find_result_t<CONTAINER>> out) noexcept
+	{
+		assert(out.size() >= keys.size());
+		size_t num_found = 0;
+		if constexpr (internal::has_prefetch<CONTAINER>::value)
+			if (container.size_in_bytes() > internal::prefetch_min_bytes)
+			{
+				static constexpr size_t batch_size = 16;// Keys hashed and prefetched ahead
+				uint64_t hashes[batch_size];
+				for (size_t start = 0; start < keys.size(); start += batch_size)
+				{
+					size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+					hash_all(container, keys.subspan(start, count), std::span<uint64_t>(hashes, count));
+					prefetch(container, std::span<const uint64_t>(hashes, count));
+					num_found += resolve(container, keys.subspan(start, count), std::span<const uint64_t>(hashes, count), out.subspan(start, count));
+				}
+				return num_found;
+			}
+
+		// Small table or nothing to prefetch
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			out[i] = container.find(keys[i]);
+			num_found += out[i] != container.end();
+		}
+		return num_found;
+	}
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Hash statistics
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	/// Counters of the calls to a 'hash_stats' hasher, shared by all its copies and safe to update from many threads.
+	/// Keeps the last 'sample_size' hashes to check how they spread on a table size.
+	/// </summary>
+	struct alignas(64) hash_counters
+	{
+		static constexpr size_t sample_size = 4096;
+		static constexpr size_t num_length_buckets = 65;// Key lengths 0, 1, [2, 4), [4, 8) ... in bytes
+
+		hash_counters() noexcept { reset(); }
+
+		/// <summary>
+		/// Record a call
+		/// </summary>
+		/// <param name="hash">The hash returned</param>
+		/// <param name="key_length">The length of the key in bytes</param>
+		forceinline void record(uint64_t hash, uint64_t key_length) noexcept
+		{
+			uint64_t index = calls.fetch_add(1, std::memory_order_relaxed);
+			samples[index & (sample_size - 1)].store(hash, std::memory_order_relaxed);
+			key_lengths[key_length ? 64 - internal::_wyclz(key_length) : 0].fetch_add(1, std::memory_order_relaxed);
+		}
+		void reset() noexcept
+		{
+			calls.store(0, std::memory_order_relaxed);
+			for (auto& count : key_lengths) count.store(0, std::memory_order_relaxed);
+			for (auto& hash : samples) hash.store(0, std::memory_order_relaxed);
+		}
+
+		/// <summary>
+		/// The number of keys hashed
+		/// </summary>
+		uint64_t num_calls() const noexcept { return calls.load(std::memory_order_relaxed); }
+		/// <summary>
+		/// Histogram of the key lengths: element [i] counts the keys of [2^(i-1), 2^i) bytes, [0] the empty keys
+		/// </summary>
+		std::array<uint64_t, num_length_buckets> key_length_histogram() const noexcept
+		{
+			std::array<uint64_t, num_length_buckets> histogram;
+			for (size_t i = 0; i < num_length_buckets; i++)
+				histogram[i] = key_lengths[i].load(std::memory_order_relaxed);
+			return histogram;
+		}
+		/// <summary>
+		/// The last hashes, at most 'sample_size'
+		/// </summary>
+		std::vector<uint64_t> sample() const
+		{
+			uint64_t num_samples = num_calls() < sample_size ? num_calls() : sample_size;
+			std::vector<uint64_t> result(num_samples);
+			for (size_t i = 0; i < num_samples; i++)
+				result[i] = samples[i].load(std::memory_order_relaxed);
+			return result;
+		}
+		/// <summary>
+		/// How the sampled hashes spread on a table: element [k] is the number of buckets with k hashes.
+		/// Power of two sizes index with the low bits like the wy containers (use the number of groups of 16 for flat_map),
+		/// else with 'wy::reduce'.
+		/// </summary>
+		/// <param name="num_buckets">The number of buckets of the table</param>
+		std::vector<uint64_t> bucket_occupancy(size_t num_buckets) const
+		{
+			std::vector<uint32_t> loads = bucket_loads(num_buckets);
+			std::vector<uint64_t> histogram;
+			for (uint32_t load : loads)
+			{
+				if (histogram.size() <= load) histogram.resize(load + 1);
+				histogram[load]++;
+			}
+			return histogram;
+		}
+		/// <summary>
+		/// Index of dispersion of the bucket loads (chi-squared / degrees of freedom): ~1 for a good hash, much bigger if the
+		/// hashes cluster, ex: hashing struct padding or only a pointer.
+		/// </summary>
+		/// <param name="num_buckets">The number of buckets of the table, at least 2</param>
+		double dispersion(size_t num_buckets) const
+		{
+			std::vector<uint32_t> loads = bucket_loads(num_buckets);
+			size_t num_samples = sample().size();
+			if (num_samples == 0 || num_buckets < 2) return 0.0;
+
+			double mean = static_cast<double>(num_samples) / static_cast<double>(num_buckets);
+			double chi2 = 0.0;
+			for (uint32_t load : loads)
+				chi2 += (load - mean) * (load - mean) / mean;
+			return chi2 / static_cast<double>(num_buckets - 1);
+		}
+
+		/// <summary>
+		/// The counters as JSON, for dashboards
+		/// </summary>
+		/// <param name="num_buckets">The number of buckets to compute the occupancy, or 0 to omit it</param>
+		std::string to_json(size_t num_buckets = 0) const
+		{
+			auto to_array = [](const auto& values, size_t size) {
+				std::string result = "[";
+				for (size_t i = 0; i < size; i++)
+					result += (i ? "," : "") + std::to_string(values[i]);
+				return result + "]";
+			};
+			std::array<uint64_t, num_length_buckets> lengths = key_length_histogram();
+			size_t used_lengths = num_length_buckets;
+			while (used_lengths && lengths[used_lengths - 1] == 0) used_lengths--;
+
+			std::string json = "{\"calls\":" + std::to_string(num_calls()) + ",\"key_length_log2\":" + to_array(lengths, used_lengths);
+			if (num_buckets)
+			{
+				std::vector<uint64_t> occupancy = bucket_occupancy(num_buckets);
+				json += ",\"num_buckets\":" + std::to_string(num_buckets) + ",\"bucket_occupancy\":" + to_array(occupancy, occupancy.size());
+				json += ",\"dispersion\":" + std::to_string(dispersion(num_buckets));
+			}
+			return json + "}";
+		}
+
+	private:
+		std::atomic<uint64_t> calls;
+		std::atomic<uint64_t> key_lengths[num_length_buckets];
+		std::atomic<uint64_t> samples[sample_size];
+
+		std::vector<uint32_t> bucket_loads(size_t num_buckets) const
+		{
+			std::vector<uint32_t> loads(num_buckets);
+			if (num_buckets == 0) return loads;
+			for (uint64_t hash : sample())
+				loads[static_cast<size_t>(is_pow2(num_buckets) ? pow2_index(hash, num_buckets) : reduce(hash, num_buckets))]++;
+			return loads;
+		}
+	};
+
+	namespace internal {
+		// Bytes hashed for a key: strings and ranges their elements, other types their size
+		template<class T, class = void> struct has_size : std::false_type {};
+		template<class T> struct has_size<T, std::void_t<decltype(std::declval<const T&>().size()), typename T::value_type>> : std::true_type {};
+		template<class T> forceinline uint64_t key_length(const T& key) noexcept
+		{
+			if constexpr (has_size<T>::value)
+				return static_cast<uint64_t>(key.size()) * sizeof(typename T::value_type);
+			else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+				return std::string_view(key).size();
+			else
+				return sizeof(T);
+		}
+
+		template<class HASHER, bool = is_transparent<HASHER>::value> struct transparent_base {};
+		template<class HASHER> struct transparent_base<HASHER, true> { using is_transparent = void; };
+	}
+
+	/// <summary>
+	/// Hasher that forwards to another and, with 'WY_INSTRUMENT' defined to 1, records statistics of its calls to diagnose
+	/// slow tables: bad mixing (clustered hashes) versus a bad load pattern (see also 'flat_map::probe_histogram()').
+	/// With 'WY_INSTRUMENT' 0 it costs nothing and can stay on the production types.
+	/// NOTE: Define 'WY_INSTRUMENT' with the same value on all the translation units of a program, for example from the
+	///       build system: the layout of hash_stats depends on it, and mixing values is an ODR violation.
+	/// </summary>
+	/// <typeparam name="HASHER">The hasher to instrument</typeparam>
+	template<class HASHER> class hash_stats : public internal::transparent_base<HASHER>
+	{
+	public:
+		explicit hash_stats(const HASHER& phasher = HASHER())
+			: hasher(phasher)
+#if WY_INSTRUMENT
+			, counters(std::make_shared<hash_counters>())
+#endif
+		{}
+
+		template<class Q> forceinline uint64_t operator()(const Q& key) const noexcept(noexcept(std::declval<const HASHER&>()(key)))
+		{
+			uint64_t hash = static_cast<uint64_t>(hasher(key));
+#if WY_INSTRUMENT
+			counters->record(hash, internal::key_length(key));
+#endif
+			return hash;
+		}
+
+		/// <summary>
+		/// The counters shared by the copies of this hasher, or null when 'WY_INSTRUMENT' is 0
+		/// </summary>
+		const hash_counters* stats() const noexcept
+		{
+#if WY_INSTRUMENT
+			return counters.get();
+#else
+			return nullptr;
+#endif
+		}
+		/// <summary>
+		/// The hasher instrumented
+		/// </summary>
+		const HASHER& base() const noexcept { return hasher; }
+
+	private:
+		HASHER hasher;
+#if WY_INSTRUMENT
+		std::shared_ptr<hash_counters> counters;
+#endif
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Concurrent hash map
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+#if WY_THREADS // concurrent_map needs <shared_mutex>
+	namespace internal {
+		/// <summary>
+		/// A shard of 'concurrent_map': a flat_map with the operations taking the hash already computed
+		/// </summary>
+		template<class KEY, class VALUE, class HASH, class KEY_EQUAL, class ALLOCATOR>
+		class concurrent_shard_table : public flat_table<KEY, std::pair<KEY, VALUE>, get_first, HASH, KEY_EQUAL, ALLOCATOR>
+		{
+			using base = flat_table<KEY, std::pair<KEY, VALUE>, get_first, HASH, KEY_EQUAL, ALLOCATOR>;
+		public:
+			using base::base;// Inherit constructors
+
+			template<class Q, class... ARGS> std::pair<typename base::iterator, bool> try_emplace_hashed(Q&& key, uint64_t hash, ARGS&&... args)
+			{
+				return this->emplace_key_hashed(key, hash, std::piecewise_construct, std::forward_as_tuple(std::forward<Q>(key)), std::forward_as_tuple(std::forward<ARGS>(args)...));
+			}
+			template<class Q> bool erase_hashed(const Q& key, uint64_t hash) noexcept
+			{
+				size_t index = this->find_index(key, hash);
+				if (index == base::npos) return false;
+				this->erase_index(index);
+				return true;
+			}
+		};
+	}
+
+	/// <summary>
+	/// Hash map safe to use from many threads, for read-heavy shared caches. The keys are split on shards, each one a
+	/// wy::flat_map behind its own std::shared_mutex: readers of a shard don't block each other, and only operations on
+	/// the same shard contend. The shard headers are padded to a cache line so that the locks don't share lines.
+	/// One wy::hash drives both the shard choice and the probe in the shard: the shard comes from the bits just below the
+	/// 7-bits tag, and the shard tables index with the low bits.
+	/// NOTE: Lookups copy the value out (or run a function under the lock with 'visit'): references would outlive the lock.
+	///       Not a seqlock: its readers run at the same time as the writers, so they would read keys and values being
+	///       modified, moved or freed by a rehash. That is only valid for trivially copyable types with epoch-based
+	///       reclamation of the tables, while a read lock works for any type and costs one atomic operation on a shard.
+	/// </summary>
+	/// <typeparam name="KEY">The type of the keys</typeparam>
+	/// <typeparam name="VALUE">The type of the mapped values</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	/// <typeparam name="KEY_EQUAL">The key comparison function</typeparam>
+	/// <typeparam name="ALLOCATOR">The allocator</typeparam>
+	template<class KEY, class VALUE, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>, class ALLOCATOR = std::allocator<std::pair<KEY, VALUE>>>
+	class concurrent_map
+	{
+		using shard_table = internal::concurrent_shard_table<KEY, VALUE, HASH, KEY_EQUAL, ALLOCATOR>;
+		template<class Q> using enable_transparent = std::enable_if_t<internal::is_transparent<HASH>::value && internal::is_transparent<KEY_EQUAL>::value && !std::is_convertible_v<const Q&, const KEY&>>;
+	public:
+		using key_type = KEY;
+		using mapped_type = VALUE;
+		using value_type = std::pair<KEY, VALUE>;
+		using size_type = size_t;
+		using hasher = HASH;
+		using key_equal = KEY_EQUAL;
+		using allocator_type = ALLOCATOR;
+
+		static constexpr size_t max_shards = 1 << 16;
+
+		/// <summary>
+		/// Create an empty map
+		/// </summary>
+		/// <param name="pnum_shards">The number of shards, rounded up to a power of two. 0 for 4 by hardware thread</param>
+		/// <param name="phash">The hash function</param>
+		/// <param name="pequal">The key comparison function</param>
+		/// <param name="palloc">The allocator of the elements</param>
+		explicit concurrent_map(size_t pnum_shards = 0, const HASH& phash = HASH(), const KEY_EQUAL& pequal = KEY_EQUAL(), const ALLOCATOR& palloc = ALLOCATOR())
+			: hash_function_(phash)
+		{
+			if (pnum_shards == 0) pnum_shards = 4 * static_cast<size_t>(std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1);
+			num_shards_ = static_cast<size_t>(next_pow2(pnum_shards > max_shards ? max_shards : pnum_shards));
+			shard_shift = 57 - internal::_wyctz(num_shards_);
+			shards.reset(new shard[num_shards_]);
+			for (size_t i = 0; i < num_shards_; i++)
+				new (&shards[i].table) shard_table(0, phash, pequal, palloc);
+		}
+		~concurrent_map()
+		{
+			for (size_t i = 0; i < num_shards_; i++)
+				shards[i].table.~shard_table();
+		}
+		concurrent_map(const concurrent_map&) = delete;
+		concurrent_map& operator=(const concurrent_map&) = delete;
+
+		////////////////////////////////////////////////////////////////////////////////////
+		// Lookup
+		////////////////////////////////////////////////////////////////////////////////////
+		/// <summary>
+		/// A copy of the value of a key, or empty if the key is not present
+		/// </summary>
+		std::optional<VALUE> find(const KEY& key) const { return find_impl(key); }
+		template<class Q, class = enable_transparent<Q>> std::optional<VALUE> find(const Q& key) const { return find_impl(key); }
+
+		bool contains(const KEY& key) const noexcept { return visit_impl(key, [](const VALUE&) noexcept {}); }
+		template<class Q, class = enable_transparent<Q>> bool contains(const Q& key) const noexcept { return visit_impl(key, [](const VALUE&) noexcept {}); }
+
+		/// <summary>
+		/// Call 'f(const VALUE&)' with the value of a key while its shard is locked for reading. 'f' must not use the map
+		/// </summary>
+		/// <returns>If the key is present</returns>
+		template<class F> bool visit(const KEY& key, F&& f) const { return visit_impl(key, std::forward<F>(f)); }
+		template<class Q, class F, class = enable_transparent<Q>> bool visit(const Q& key, F&& f) const { return visit_impl(key, std::forward<F>(f)); }
+
+		////////////////////////////////////////////////////////////////////////////////////
+		// Modifiers
+		////////////////////////////////////////////////////////////////////////////////////
+		/// <summary>
+		/// Insert a value constructed in-place if the key is not present
+		/// </summary>
+		/// <returns>If the value was inserted</returns>
+		template<class... ARGS> bool try_emplace(const KEY& key, ARGS&&... args) { return emplace_impl(key, std::forward<ARGS>(args)...); }
+		template<class... ARGS> bool try_emplace(KEY&& key, ARGS&&... args) { return emplace_impl(std::move(key), std::forward<ARGS>(args)...); }
+		bool insert(const value_type& value) { return emplace_impl(value.first, value.second); }
+
+		/// <summary>
+		/// Insert a value or assign it to the current one if the key is present
+		/// </summary>
+		/// <returns>If the value was inserted</returns>
+		template<class M> bool insert_or_assign(const KEY& key, M&& obj)
+		{
+			uint64_t hash = hash_key(key);
+			shard& s = shard_of(hash);
+			std::unique_lock lock(s.mutex);
+			auto [it, inserted] = s.table.try_emplace_hashed(key, hash, std::forward<M>(obj));
+			if (!inserted) it->second = std::forward<M>(obj);
+			return inserted;
+		}
+
+		/// <summary>
+		/// Call 'f(VALUE&)' with the value of a key while its shard is locked for writing. 'f' must not use the map
+		/// </summary>
+		/// <returns>If the key is present</returns>
+		template<class F> bool update(const KEY& key, F&& f)
+		{
+			uint64_t hash = hash_key(key);
+			shard& s = shard_of(hash);
+			std::unique_lock lock(s.mutex);
+			auto it = s.table.find(key, hash);
+			if (it == s.table.end()) return false;
+			f(it->second);
+			return true;
+		}
+
+		/// <summary>
+		/// Remove a key
+		/// </summary>
+		/// <returns>If the key was present</returns>
+		bool erase(const KEY& key) { return erase_impl(key); }
+		template<class Q, class = enable_transparent<Q>> bool erase(const Q& key) { return erase_impl(key); }
+
+		void clear()
+		{
+			for (size_t i = 0; i < num_shards_; i++)
+			{
+				std::unique_lock lock(shards[i].mutex);
+				shards[i].table.clear();
+			}
+		}
+		/// <summary>
+		/// Prepare the shards for 'count' elements spread uniformly
+		/// </summary>
+		void reserve(size_t count)
+		{
+			size_t by_shard = count / num_shards_ + count / num_shards_ / 8 + 1;// Some margin for the variance of the shard sizes
+			for (size_t i = 0; i < num_shards_; i++)
+			{
+				std::unique_lock lock(shards[i].mutex);
+				shards[i].table.reserve(by_shard);
+			}
+		}
+
+		////////////////////////////////////////////////////////////////////////////////////
+		// Traversal and capacity
+		////////////////////////////////////////////////////////////////////////////////////
+		/// <summary>
+		/// Call 'f(const KEY&, const VALUE&)' for each element, locking the shards for reading one by one:
+		/// not a snapshot of the map if other threads modify it. 'f' must not use the map
+		/// </summary>
+		template<class F> void for_each(F&& f) const
+		{
+			for (size_t i = 0; i < num_shards_; i++)
+			{
+				std::shared_lock lock(shards[i].mutex);
+				for (const value_type& elem : shards[i].table)
+					f(elem.first, elem.second);
+			}
+		}
+		/// <summary>
+		/// The number of elements: the sum of the shards, each one read at a different time
+		/// </summary>
+		size_t size() const noexcept
+		{
+			size_t total = 0;
+			for (size_t i = 0; i < num_shards_; i++)
+			{
+				std::shared_lock lock(shards[i].mutex);
+				total += shards[i].table.size();
+			}
+			return total;
+		}
+		bool empty() const noexcept { return size() == 0; }
+		size_t num_shards() const noexcept { return num_shards_; }
+		hasher hash_function() const { return hash_function_; }
+
+	private:
+		struct alignas(64) shard
+		{
+			mutable std::shared_mutex mutex;
+			union { shard_table table; };// Constructed with the parameters of the map
+			shard() noexcept {}
+			~shard() {}
+		};
+
+		std::unique_ptr<shard[]> shards;
+		size_t num_shards_;
+		uint32_t shard_shift;
+		HASH hash_function_;
+
+		template<class Q> forceinline uint64_t hash_key(const Q& key) const noexcept { return static_cast<uint64_t>(hash_function_(key)); }
+		forceinline shard& shard_of(uint64_t hash) const noexcept { return shards[(hash >> shard_shift) & (num_shards_ - 1)]; }
+
+		template<class Q> std::optional<VALUE> find_impl(const Q& key) const
+		{
+			uint64_t hash = hash_key(key);
+			const shard& s = shard_of(hash);
+			std::shared_lock lock(s.mutex);
+			auto it = s.table.find(key, hash);
+			if (it == s.table.end()) return std::nullopt;
+			return it->second;
+		}
+		template<class Q, class F> bool visit_impl(const Q& key, F&& f) const
+		{
+			uint64_t hash = hash_key(key);
+			const shard& s = shard_of(hash);
+			std::shared_lock lock(s.mutex);
+			auto it = s.table.find(key, hash);
+			if (it == s.table.end()) return false;
+			f(static_cast<const VALUE&>(it->second));
+			return true;
+		}
+		template<class K, class... ARGS> bool emplace_impl(K&& key, ARGS&&... args)
+		{
+			uint64_t hash = hash_key(key);
+			shard& s = shard_of(hash);
+			std::unique_lock lock(s.mutex);
+			return s.table.try_emplace_hashed(std::forward<K>(key), hash, std::forward<ARGS>(args)...).second;
+		}
+		template<class Q> bool erase_impl(const Q& key)
+		{
+			uint64_t hash = hash_key(key);
+			shard& s = shard_of(hash);
+			std::unique_lock lock(s.mutex);
+			return s.table.erase_hashed(key, hash);
+		}
+	};
+#endif
+
+	/// <summary>
+	/// Read-only hash map built once from a fixed set of keys, without collisions (minimal perfect hashing).
+	/// Keys are distributed on buckets of ~3 elements. Each bucket stores a 'pilot' that mixed with the hash of a key
+	/// gives its slot, found at construction trying pilots until all the keys of the bucket land on free slots
+	/// (CHD/PTHash displacement). Buckets with only one key store its slot directly. When a bucket can't be placed, the
+	/// table is built again with other hash seed (this needs 'HASH(uint64_t seed)', like wy::hash, otherwise the hash is remixed).
+	/// A lookup is one hash, two array reads (pilot and slot) and one key comparison.
+	/// NOTE: Keys repeated on construction are discarded, keeping the first one.
+	/// </summary>
+	/// <typeparam name="KEY">The type of the keys</typeparam>
+	/// <typeparam name="VALUE">The type of the values</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	/// <typeparam name="KEY_EQUAL">The key comparison function</typeparam>
+	template<class KEY, class VALUE, class HASH = wy::hash<KEY>, class KEY_EQUAL = std::equal_to<>>
+	class perfect_hash_map
+	{
+	public:
+		using key_type = KEY;
+		using mapped_type = VALUE;
+		using value_type = std::pair<const KEY, VALUE>;
+		using size_type = size_t;
+		using hasher = HASH;
+		using key_equal = KEY_EQUAL;
+		using iterator = typename std::vector<value_type>::iterator;
+		using const_iterator = typename std::vector<value_type>::const_iterator;
+
+		perfect_hash_map() = default;
+		/// <summary>
+		/// Build the map from the elements on a range
+		/// </summary>
+		template<class INPUT_IT> perfect_hash_map(INPUT_IT first, INPUT_IT last, const KEY_EQUAL& equal = KEY_EQUAL()) : key_eq_(equal)
+		{
+			std::vector<std::pair<KEY, VALUE>> elems(first, last);
+			build(elems);
+		}
+		perfect_hash_map(std::initializer_list<std::pair<KEY, VALUE>> init, const KEY_EQUAL& equal = KEY_EQUAL()) : perfect_hash_map(init.begin(), init.end(), equal) {}
+		/// <summary>
+		/// Build the map moving the elements
+		/// </summary>
+		perfect_hash_map(std::vector<std::pair<KEY, VALUE>>&& elems, const KEY_EQUAL& equal = KEY_EQUAL()) : key_eq_(equal)
+		{
+			build(elems);
+		}
+
+		iterator begin() noexcept { return slots.begin(); }
+		const_iterator begin() const noexcept { return slots.begin(); }
+		const_iterator cbegin() const noexcept { return slots.begin(); }
+		iterator end() noexcept { return slots.end(); }
+		const_iterator end() const noexcept { return slots.end(); }
+		const_iterator cend() const noexcept { return slots.end(); }
+
+		bool empty() const noexcept { return slots.empty(); }
+		size_t size() const noexcept { return slots.size(); }
+		hasher hash_function() const { return hash_function_; }
+		key_equal key_eq() const { return key_eq_; }
+		/// <summary>
+		/// The seed used to build the table (the number of rebuilds needed)
+		/// </summary>
+		uint64_t seed() const noexcept { return seed_; }
+
+		////////////////////////////////////////////////////////////////////////////////////
+		// Lookup
+		////////////////////////////////////////////////////////////////////////////////////
+		iterator find(const KEY& key) noexcept { return begin() + static_cast<ptrdiff_t>(find_index(key)); }
+		const_iterator find(const KEY& key) const noexcept { return begin() + static_cast<ptrdiff_t>(find_index(key)); }
+		bool contains(const KEY& key) const noexcept { return find_index(key) != slots.size(); }
+		size_t count(const KEY& key) const noexcept { return contains(key) ? 1 : 0; }
+
+		// Heterogeneous lookup, enabled when both the hash and the key comparison declare 'is_transparent'
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		iterator find(const Q& key) noexcept { return begin() + static_cast<ptrdiff_t>(find_index(key)); }
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		const_iterator find(const Q& key) const noexcept { return begin() + static_cast<ptrdiff_t>(find_index(key)); }
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		bool contains(const Q& key) const noexcept { return find_index(key) != slots.size(); }
+		template<class Q, class H = HASH, class E = KEY_EQUAL, class = std::enable_if_t<internal::is_transparent<H>::value && internal::is_transparent<E>::value>>
+		size_t count(const Q& key) const noexcept { return contains(key) ? 1 : 0; }
+
+		VALUE& at(const KEY& key)
+		{
+			auto it = find(key);
+			if (it == end()) throw std::out_of_range("wy::perfect_hash_map::at: key not found");
+			return it->second;
+		}
+		const VALUE& at(const KEY& key) const
+		{
+			auto it = find(key);
+			if (it == end()) throw std::out_of_range("wy::perfect_hash_map::at: key not found");
+			return it->second;
+		}
+
+	private:
+		static constexpr uint32_t direct_slot = 0x80000000u;// Pilot flag: the bucket has one key, stored on the slot in the low bits
+		static constexpr uint32_t max_pilot = 1u << 16;// Pilots tried on a bucket before rebuilding with other seed
+		static constexpr size_t bucket_size = 3;// Average keys by bucket
+
+		std::vector<value_type> slots;
+		std::vector<uint32_t> pilots;
+		HASH hash_function_;
+		KEY_EQUAL key_eq_;
+		uint64_t seed_ = 0;
+
+		template<class Q> forceinline uint64_t hash_key(const Q& key) const noexcept
+		{
+			if constexpr (std::is_constructible_v<HASH, uint64_t>)
+				return static_cast<uint64_t>(hash_function_(key));
+			else
+				return seed_ ? internal::wyhash64(static_cast<uint64_t>(hash_function_(key)), seed_) : static_cast<uint64_t>(hash_function_(key));
+		}
+		static forceinline size_t slot_of(uint64_t hash, uint32_t pilot, size_t num_slots) noexcept
+		{
+			// Mix with the pilot, then reduce to [0, num_slots) with a multiply
+			return static_cast<size_t>(internal::_wymulhi(internal::_wymix(hash ^ 0xa0761d6478bd642full, pilot ^ 0xe7037ed1a0b428dbull), num_slots));
+		}
+		template<class Q> forceinline size_t find_index(const Q& key) const noexcept
+		{
+			if (slots.empty()) return 0;
+
+			uint64_t hash = hash_key(key);
+			uint32_t pilot = pilots[internal::_wymulhi(hash, pilots.size())];
+			size_t index = (pilot & direct_slot) ? (pilot & ~direct_slot) : slot_of(hash, pilot, slots.size());
+			return key_eq_(slots[index].first, key) ? index : slots.size();
+		}
+
+		void build(std::vector<std::pair<KEY, VALUE>>& elems)
+		{
+			assert(elems.size() < direct_slot && "wy::perfect_hash_map supports up to 2^31 keys");
+
+			std::vector<size_t> slot_elem;
+			for (seed_ = 0; !try_build(elems, slot_elem); seed_++)
+			{
+				// With 64-bits hashes a rebuild is rare. Only a broken hash function would get here
+				if (seed_ == 64) throw std::invalid_argument("wy::perfect_hash_map: the hash function can't separate the keys");
+			}
+
+			slots.reserve(slot_elem.size());
+			for (size_t elem_index : slot_elem)
+				slots.emplace_back(std::move(elems[elem_index]));
+		}
+		/// <summary>
+		/// Try to place all keys with the current seed
+		/// </summary>
+		/// <param name="elems">The elements to place</param>
+		/// <param name="slot_elem">out: The index of the element on each slot</param>
+		/// <returns>True if successful</returns>
+		bool try_build(const std::vector<std::pair<KEY, VALUE>>& elems, std::vector<size_t>& slot_elem)
+		{
+			if constexpr (std::is_constructible_v<HASH, uint64_t>)
+				hash_function_ = seed_ ? HASH(seed_) : HASH();
+
+			struct entry { size_t bucket; uint64_t hash; size_t elem; };
+			size_t num_buckets = elems.size() / bucket_size + 1;
+			std::vector<entry> entries(elems.size());
+			for (size_t i = 0; i < elems.size(); i++)
+			{
+				uint64_t hash = hash_key(elems[i].first);
+				entries[i] = { static_cast<size_t>(internal::_wymulhi(hash, num_buckets)), hash, i };
+			}
+			std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+				return a.bucket != b.bucket ? a.bucket < b.bucket : (a.hash != b.hash ? a.hash < b.hash : a.elem < b.elem);
+			});
+
+			// Remove repeated keys and find the buckets
+			struct bucket_range { size_t bucket, begin, size; };
+			std::vector<bucket_range> buckets;
+			size_t num_keys = 0;
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				if (i > 0 && entries[i - 1].hash == entries[i].hash)
+				{
+					if (!key_eq_(elems[entries[i - 1].elem].first, elems[entries[i].elem].first)) return false;// Collision of full hashes
+					continue;
+				}
+
+				entries[num_keys] = entries[i];
+				if (buckets.empty() || buckets.back().bucket != entries[i].bucket)
+					buckets.push_back({ entries[i].bucket, num_keys, 0 });
+				buckets.back().size++;
+				num_keys++;
+			}
+			std::stable_sort(buckets.begin(), buckets.end(), [](const bucket_range& a, const bucket_range& b) { return a.size > b.size; });
+
+			// Place the biggest buckets first, when the table is emptier
+			pilots.assign(num_buckets, 0);
+			slot_elem.assign(num_keys, SIZE_MAX);
+			std::vector<size_t> positions;
+			size_t b = 0;
+			for (; b < buckets.size() && buckets[b].size > 1; b++)
+			{
+				const bucket_range& bucket = buckets[b];
+				uint32_t pilot = 0;
+				for (; pilot < max_pilot; pilot++)
+				{
+					positions.clear();
+					for (size_t i = 0; i < bucket.size; i++)
+					{
+						size_t pos = slot_of(entries[bucket.begin + i].hash, pilot, num_keys);
+						if (slot_elem[pos] != SIZE_MAX || std::find(positions.begin(), positions.end(), pos) != positions.end()) break;
+						positions.push_back(pos);
+					}
+					if (positions.size() == bucket.size) break;
+				}
+				if (pilot == max_pilot) return false;
+
+				pilots[bucket.bucket] = pilot;
+				for (size_t i = 0; i < bucket.size; i++)
+					slot_elem[positions[i]] = entries[bucket.begin + i].elem;
+			}
+			// Buckets of one key go directly to the free slots
+			size_t free_slot = 0;
+			for (; b < buckets.size(); b++)
+			{
+				while (slot_elem[free_slot] != SIZE_MAX) free_slot++;
+				pilots[buckets[b].bucket] = direct_slot | static_cast<uint32_t>(free_slot);
+				slot_elem[free_slot] = entries[buckets[b].begin].elem;
+			}
+
+			return true;
+		}
+	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Probabilistic filters
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	/// Blocked Bloom filter: approximate set membership without false negatives.
+	/// All the bits of a key are on the same 512-bits block (one cache line), so a lookup is one cache miss.
+	/// The block is selected by the high bits of one wy::hash result and the k bits by double hashing of its low 32 bits.
+	/// </summary>
+	/// <typeparam name="T">The type of the keys</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	template<class T, class HASH = wy::hash<T>> class bloom_filter
+	{
+	public:
+		/// <summary>
+		/// Create a filter for a number of keys with a false positive rate
+		/// </summary>
+		/// <param name="expected_elements">The number of keys expected to be inserted</param>
+		/// <param name="false_positive_rate">The rate of false positives wanted at 'expected_elements'</param>
+		/// <param name="hash">The hash function</param>
+		/// <exception cref="std::invalid_argument">Thrown when the false positive rate is not in (0, 1)</exception>
+		bloom_filter(size_t expected_elements, double false_positive_rate = 0.01, const HASH& hash = HASH()) : hash_function_(hash)
+		{
+			if (!(false_positive_rate > 0 && false_positive_rate < 1))// Also rejects NaN
+				throw std::invalid_argument("wy::bloom_filter: the false positive rate must be in (0, 1)");
+			double n = static_cast<double>(expected_elements ? expected_elements : 1);
+			double ln2 = 0.69314718055994530942;
+			double bits = -n * std::log(false_positive_rate) / (ln2 * ln2);
+			// Blocking gives a small increase in false positives, compensated with 10% more bits
+			blocks.resize(static_cast<size_t>(bits * 1.1 / block_bits) + 1);
+			double k = bits / n * ln2;
+			num_hashes_ = k < 1 ? 1 : (k > 16 ? 16 : static_cast<uint32_t>(k + 0.5));
+		}
+
+		/// <summary>
+		/// Insert a key
+		/// </summary>
+		forceinline void insert(const T& key) noexcept { insert_hash(static_cast<uint64_t>(hash_function_(key))); }
+		/// <summary>
+		/// Check if a key may be on the filter
+		/// </summary>
+		/// <returns>False if the key was never inserted, true if it probably was</returns>
+		forceinline bool contains(const T& key) const noexcept { return contains_hash(static_cast<uint64_t>(hash_function_(key))); }
+
+		/// <summary>
+		/// Insert a key from its hash, when the hash was already computed
+		/// </summary>
+		forceinline void insert_hash(uint64_t hash) noexcept
+		{
+			block& b = blocks[block_index(hash)];
+			uint32_t h1 = static_cast<uint32_t>(hash), h2 = (static_cast<uint32_t>(hash) >> 16) | 1;
+			for (uint32_t i = 0; i < num_hashes_; i++, h1 += h2)
+				b.words[(h1 >> 6) & 7] |= 1ull << (h1 & 63);
+		}
+		forceinline bool contains_hash(uint64_t hash) const noexcept
+		{
+			const block& b = blocks[block_index(hash)];
+			uint32_t h1 = static_cast<uint32_t>(hash), h2 = (static_cast<uint32_t>(hash) >> 16) | 1;
+			uint64_t found = 1;
+			for (uint32_t i = 0; i < num_hashes_; i++, h1 += h2)
+				found &= b.words[(h1 >> 6) & 7] >> (h1 & 63);
+			return found;
+		}
+
+#ifdef __cpp_lib_span
+		/// <summary>
+		/// Insert many keys. The keys are hashed by groups and their blocks prefetched to overlap the cache misses.
+		/// </summary>
+		void insert(std::span<const T> keys) noexcept
+		{
+			uint64_t hashes[batch_size];
+			for (size_t start = 0; start < keys.size(); start += batch_size)
+			{
+				size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+				prefetch_batch(keys.data() + start, hashes, count);
+				for (size_t i = 0; i < count; i++)
+					insert_hash(hashes[i]);
+			}
+		}
+		/// <summary>
+		/// Check many keys. The keys are hashed by groups and their blocks prefetched to overlap the cache misses.
+		/// </summary>
+		/// <param name="keys">The keys to check</param>
+		/// <param name="results">out: For each key, if it may be on the filter</param>
+		/// <returns>The number of keys that may be on the filter</returns>
+		size_t contains(std::span<const T> keys, std::span<bool> results) const noexcept
+		{
+			assert(results.size() >= keys.size());
+
+			uint64_t hashes[batch_size];
+			size_t num_found = 0;
+			for (size_t start = 0; start < keys.size(); start += batch_size)
+			{
+				size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+				prefetch_batch(keys.data() + start, hashes, count);
+				for (size_t i = 0; i < count; i++)
+				{
+					bool found = contains_hash(hashes[i]);
+					results[start + i] = found;
+					num_found += found;
+				}
+			}
+			return num_found;
+		}
+#endif
+
+		/// <summary>
+		/// Remove all the keys
+		/// </summary>
+		void clear() noexcept { std::fill(blocks.begin(), blocks.end(), block{}); }
+		/// <summary>
+		/// Add the keys of other filter of the same size and hash function
+		/// </summary>
+		void merge(const bloom_filter& other) noexcept
+		{
+			assert(blocks.size() == other.blocks.size() && num_hashes_ == other.num_hashes_);
+			for (size_t i = 0; i < blocks.size(); i++)
+				for (size_t j = 0; j < 8; j++)
+					blocks[i].words[j] |= other.blocks[i].words[j];
+		}
+
+		size_t size_in_bytes() const noexcept { return blocks.size() * sizeof(block); }
+		uint32_t num_hashes() const noexcept { return num_hashes_; }
+		HASH hash_function() const { return hash_function_; }
+
+	private:
+		static constexpr size_t block_bits = 512;
+		static constexpr size_t batch_size = 16;// Keys hashed and prefetched ahead on the batch methods
+		struct alignas(64) block { uint64_t words[8] = {}; };
+
+		std::vector<block> blocks;
+		uint32_t num_hashes_;
+		HASH hash_function_;
+
+		forceinline size_t block_index(uint64_t hash) const noexcept { return static_cast<size_t>(internal::_wymulhi(hash, blocks.size())); }
+		forceinline void prefetch_batch(const T* keys, uint64_t* hashes, size_t count) const noexcept
+		{
+			bool prefetch = size_in_bytes() > internal::prefetch_min_bytes;
+			for (size_t i = 0; i < count; i++)
+			{
+				hashes[i] = static_cast<uint64_t>(hash_function_(keys[i]));
+				if (prefetch) internal::_wyprefetch(&blocks[block_index(hashes[i])]);
+			}
+		}
+	};
+
+	/// <summary>
+	/// Cuckoo filter: approximate set membership that supports deletion.
+	/// Stores a 16-bits fingerprint of each key on one of its two buckets of 4 slots, with a false positive rate ~0.01%.
+	/// One wy::hash result gives the first bucket (low bits) and the fingerprint (high bits). The second bucket is
+	/// the first xor the hash of the fingerprint, so entries can be moved knowing only their fingerprint.
+	/// A bucket is one 64-bits word and is checked for the fingerprint without branches.
+	/// </summary>
+	/// <typeparam name="T">The type of the keys</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	template<class T, class HASH = wy::hash<T>> class cuckoo_filter
+	{
+	public:
+		/// <summary>
+		/// Create a filter for a maximum number of keys
+		/// </summary>
+		/// <param name="max_elements">The number of keys expected to be inserted</param>
+		/// <param name="hash">The hash function</param>
+		cuckoo_filter(size_t max_elements, const HASH& hash = HASH()) : hash_function_(hash)
+		{
+			// Inserts succeed with high probability up to a 95% load
+			size_t needed = static_cast<size_t>(static_cast<double>(max_elements) / (slots_by_bucket * 0.95)) + 1;
+			size_t num_buckets = 1;
+			while (num_buckets < needed) num_buckets *= 2;
+			buckets.resize(num_buckets);
+		}
+
+		/// <summary>
+		/// Insert a key
+		/// </summary>
+		/// <returns>False if the filter is full. Then the key is still found, but no more keys can be inserted</returns>
+		bool insert(const T& key) noexcept { return insert_hash(static_cast<uint64_t>(hash_function_(key))); }
+		/// <summary>
+		/// Check if a key may be on the filter
+		/// </summary>
+		/// <returns>False if the key is not on the filter, true if it probably is</returns>
+		bool contains(const T& key) const noexcept { return contains_hash(static_cast<uint64_t>(hash_function_(key))); }
+		/// <summary>
+		/// Remove a key. Only keys inserted before can be removed, or false negatives may appear.
+		/// </summary>
+		/// <returns>True if a fingerprint of the key was removed</returns>
+		bool erase(const T& key) noexcept { return erase_hash(static_cast<uint64_t>(hash_function_(key))); }
+
+		bool insert_hash(uint64_t hash) noexcept
+		{
+			if (has_victim) return false;
+
+			uint16_t fp = fingerprint(hash);
+			size_t i1 = first_bucket(hash), i2 = other_bucket(i1, fp);
+			if (add(i1, fp) || add(i2, fp)) { size_++; return true; }
+
+			// Kick fingerprints to their other bucket until a free slot is found
+			size_t index = (kick_state & 1) ? i1 : i2;
+			for (uint32_t kick = 0; kick < max_kicks; kick++)
+			{
+				uint32_t slot = static_cast<uint32_t>(internal::wyrand(&kick_state)) & (slots_by_bucket - 1);
+				uint16_t old_fp = get(index, slot);
+				set(index, slot, fp);
+				fp = old_fp;
+				index = other_bucket(index, fp);
+				if (add(index, fp)) { size_++; return true; }
+			}
+			// Full: keep the last fingerprint apart to not lose it
+			has_victim = true;
+			victim_fp = fp;
+			victim_index = index;
+			size_++;
+			return false;
+		}
+		bool contains_hash(uint64_t hash) const noexcept
+		{
+			uint16_t fp = fingerprint(hash);
+			size_t i1 = first_bucket(hash), i2 = other_bucket(i1, fp);
+			return has_fingerprint(buckets[i1], fp) | has_fingerprint(buckets[i2], fp) | (has_victim && victim_fp == fp && (victim_index == i1 || victim_index == i2));
+		}
+		bool erase_hash(uint64_t hash) noexcept
+		{
+			uint16_t fp = fingerprint(hash);
+			size_t i1 = first_bucket(hash), i2 = other_bucket(i1, fp);
+			if (has_victim && victim_fp == fp && (victim_index == i1 || victim_index == i2)) { has_victim = false; size_--; return true; }
+			if (remove(i1, fp) || remove(i2, fp))
+			{
+				size_--;
+				// Move the victim back to the table if there is space now
+				if (has_victim && (add(victim_index, victim_fp) || add(other_bucket(victim_index, victim_fp), victim_fp))) has_victim = false;
+				return true;
+			}
+			return false;
+		}
+
+#ifdef __cpp_lib_span
+		/// <summary>
+		/// Insert many keys. The keys are hashed by groups and their buckets prefetched to overlap the cache misses.
+		/// </summary>
+		/// <returns>The number of keys inserted before the filter was full</returns>
+		size_t insert(std::span<const T> keys) noexcept
+		{
+			uint64_t hashes[batch_size];
+			for (size_t start = 0; start < keys.size(); start += batch_size)
+			{
+				size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+				prefetch_batch(keys.data() + start, hashes, count);
+				for (size_t i = 0; i < count; i++)
+					if (!insert_hash(hashes[i])) return start + i;
+			}
+			return keys.size();
+		}
+		/// <summary>
+		/// Check many keys. The keys are hashed by groups and their buckets prefetched to overlap the cache misses.
+		/// </summary>
+		/// <param name="keys">The keys to check</param>
+		/// <param name="results">out: For each key, if it may be on the filter</param>
+		/// <returns>The number of keys that may be on the filter</returns>
+		size_t contains(std::span<const T> keys, std::span<bool> results) const noexcept
+		{
+			assert(results.size() >= keys.size());
+
+			uint64_t hashes[batch_size];
+			size_t num_found = 0;
+			for (size_t start = 0; start < keys.size(); start += batch_size)
+			{
+				size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+				prefetch_batch(keys.data() + start, hashes, count);
+				for (size_t i = 0; i < count; i++)
+				{
+					bool found = contains_hash(hashes[i]);
+					results[start + i] = found;
+					num_found += found;
+				}
+			}
+			return num_found;
+		}
+#endif
+
+		/// <summary>
+		/// Remove all the keys
+		/// </summary>
+		void clear() noexcept { std::fill(buckets.begin(), buckets.end(), uint64_t(0)); size_ = 0; has_victim = false; }
+
+		size_t size() const noexcept { return size_; }
+		bool empty() const noexcept { return size_ == 0; }
+		size_t capacity() const noexcept { return buckets.size() * slots_by_bucket; }
+		size_t size_in_bytes() const noexcept { return buckets.size() * sizeof(uint64_t); }
+		HASH hash_function() const { return hash_function_; }
+
+	private:
+		static constexpr uint32_t slots_by_bucket = 4;
+		static constexpr uint32_t max_kicks = 500;
+		static constexpr size_t batch_size = 16;// Keys hashed and prefetched ahead on the batch methods
+		static constexpr uint64_t lanes_one = 0x0001000100010001ull;
+		static constexpr uint64_t lanes_high = 0x8000800080008000ull;
+
+		std::vector<uint64_t> buckets;// 4 fingerprints of 16-bits by bucket, 0 is a free slot
+		size_t size_ = 0;
+		uint64_t kick_state = 0;// wyrand state to select the fingerprints to kick
+		bool has_victim = false;
+		uint16_t victim_fp = 0;
+		size_t victim_index = 0;
+		HASH hash_function_;
+
+		static forceinline uint16_t fingerprint(uint64_t hash) noexcept
+		{
+			uint16_t fp = static_cast<uint16_t>(hash >> 48);
+			return fp ? fp : 1;// 0 marks free slots
+		}
+		forceinline size_t first_bucket(uint64_t hash) const noexcept { return static_cast<size_t>(hash) & (buckets.size() - 1); }
+		forceinline size_t other_bucket(size_t index, uint16_t fp) const noexcept
+		{
+			return (index ^ static_cast<size_t>(fp * 0xc6a4a7935bd1e995ull >> 32)) & (buckets.size() - 1);// An involution: other(other(i)) == i
+		}
+		static forceinline bool has_fingerprint(uint64_t bucket, uint16_t fp) noexcept
+		{
+			uint64_t x = bucket ^ (fp * lanes_one);// Lanes equal to fp become zero
+			return ((x - lanes_one) & ~x & lanes_high) != 0;
+		}
+		forceinline uint16_t get(size_t index, uint32_t slot) const noexcept { return static_cast<uint16_t>(buckets[index] >> (slot * 16)); }
+		forceinline void set(size_t index, uint32_t slot, uint16_t fp) noexcept
+		{
+			buckets[index] = (buckets[index] & ~(0xffffull << (slot * 16))) | (static_cast<uint64_t>(fp) << (slot * 16));
+		}
+		forceinline bool add(size_t index, uint16_t fp) noexcept
+		{
+			for (uint32_t slot = 0; slot < slots_by_bucket; slot++)
+				if (get(index, slot) == 0) { set(index, slot, fp); return true; }
+			return false;
+		}
+		forceinline bool remove(size_t index, uint16_t fp) noexcept
+		{
+			for (uint32_t slot = 0; slot < slots_by_bucket; slot++)
+				if (get(index, slot) == fp) { set(index, slot, 0); return true; }
+			return false;
+		}
+		forceinline void prefetch_batch(const T* keys, uint64_t* hashes, size_t count) const noexcept
+		{
+			if (size_in_bytes() <= internal::prefetch_min_bytes)
 			{
-				// make your own secret
-				// code taken from 'wyhash.h::make_secret(seed, secret)'
-				uint8_t c[] = { 15, 23, 27, 29, 30, 39, 43, 45, 46, 51, 53, 54, 57, 58, 60, 71, 75, 77, 78, 83, 85, 86, 89, 90, 92, 99, 101, 102, 105, 106, 108, 113, 114, 116, 120, 135, 139, 141, 142, 147, 149, 150, 153, 154, 156, 163, 165, 166, 169, 170, 172, 177, 178, 180, 184, 195, 197, 198, 201, 202, 204, 209, 210, 212, 216, 225, 226, 228, 232, 240 };
-				for (size_t i = 0; i < 4; i++) {
-					uint8_t ok;
-					do {
-						ok = 1; secret[i] = 0;
-						for (size_t j = 0; j < 64; j += 8) secret[i] |= ((uint64_t)c[wyrand(&seed) % sizeof(c)]) << j;
-						if (secret[i] % 2 == 0) { ok = 0; continue; }
-						for (size_t j = 0; j < i; j++) {
-#if defined(__GNUC__) || defined(__INTEL_COMPILER) || defined(__clang__)
-							if (__builtin_popcountll(secret[j] ^ secret[i]) != 32) { ok = 0; break; }
-#elif defined(_MSC_VER) && defined(_M_X64)
-							if (_mm_popcnt_u64(secret[j] ^ secret[i]) != 32) { ok = 0; break; }
-#else
-							// manual popcount
-							uint64_t x = secret[j] ^ secret[i];
-							x -= (x >> 1) & 0x5555555555555555;
-							x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
-							x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0f;
-							x = (x * 0x0101010101010101) >> 56;
-							if (x != 32) { ok = 0; break; }
-#endif
-						}
-					} while (!ok);
-				}
+				for (size_t i = 0; i < count; i++)
+					hashes[i] = static_cast<uint64_t>(hash_function_(keys[i]));
+				return;
 			}
-			/// <summary>
-			/// Create a wyhasher with a specific secret
-			/// </summary>
-			/// <param name="secret">The secret to use</param>
-			hash_imp(const uint64_t psecret[4]) noexcept
+			for (size_t i = 0; i < count; i++)
 			{
-				memcpy(secret, psecret, sizeof(secret));
+				hashes[i] = static_cast<uint64_t>(hash_function_(keys[i]));
+				uint16_t fp = fingerprint(hashes[i]);
+				size_t i1 = first_bucket(hashes[i]);
+				internal::_wyprefetch(&buckets[i1]);
+				internal::_wyprefetch(&buckets[other_bucket(i1, fp)]);
 			}
+		}
+	};
 
-			/// <summary>
-			/// Hash general data
-			/// </summary>
-			/// <param name="data">The data to hash</param>
-			/// <param name="len">The size of the data</param>
-			/// <returns>A 64-bits hash</returns>
-			forceinline uint64_t wyhash(const uint8_t* data, size_t len) const noexcept
+	namespace internal {
+		// dst[i] = max(dst[i], src[i])
+		static forceinline void _wymax_u8(uint8_t* dst, const uint8_t* src, size_t n) noexcept
+		{
+			size_t i = 0;
+#if defined(__AVX2__)
+			for (; i + 32 <= n; i += 32)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_max_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i)), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+#endif
+#if WY_HAS_SSE2
+			for (; i + 16 <= n; i += 16)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+#elif WY_HAS_NEON
+			for (; i + 16 <= n; i += 16)
+				vst1q_u8(dst + i, vmaxq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+#endif
+			for (; i < n; i++)
+				dst[i] = dst[i] > src[i] ? dst[i] : src[i];
+		}
+	}
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Cardinality estimation
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	/// <summary>
+	/// HyperLogLog sketch: estimates the number of distinct keys with 2^PRECISION bytes, with a standard error of ~1.04/sqrt(2^PRECISION).
+	/// Small sets are kept on a sparse representation with 25-bits precision, nearly exact, moving to the dense registers
+	/// when that would use less memory. The dense estimate uses the improved estimator of Otmar Ertl, without bias tables.
+	/// Sketches are not thread-safe: use one by thread (or shard) and merge them, a merge is a SIMD max of the registers.
+	/// </summary>
+	/// <typeparam name="T">The type of the keys</typeparam>
+	/// <typeparam name="PRECISION">log2 of the number of registers, between 4 and 18</typeparam>
+	/// <typeparam name="HASH">The hash function</typeparam>
+	template<class T, uint32_t PRECISION = 14, class HASH = wy::hash<T>> class hyperloglog
+	{
+		static_assert(PRECISION >= 4 && PRECISION <= 18, "hyperloglog PRECISION should be between 4 and 18");
+
+	public:
+		static constexpr size_t num_registers = size_t(1) << PRECISION;
+
+		hyperloglog(const HASH& hash = HASH()) : hash_function_(hash) {}
+
+		/// <summary>
+		/// Add a key
+		/// </summary>
+		forceinline void add(const T& key) { add_hash(static_cast<uint64_t>(hash_function_(key))); }
+		/// <summary>
+		/// Add a key from its hash, when the hash was already computed
+		/// </summary>
+		forceinline void add_hash(uint64_t hash)
+		{
+			if (_likely_(!registers.empty()))
 			{
-				// code taken from 'wyhash.h::wyhash(const void* key, size_t len, uint64_t seed, const uint64_t * secret)' with seed=0
-				const uint8_t* p = (const uint8_t*)data;
-				uint64_t seed = secret[0], a, b;
-				if (_likely_(len <= 16)) {
-					if (_likely_(len >= 4)) { a = (_wyr4(p) << 32) | _wyr4(p + ((len >> 3) << 2)); b = (_wyr4(p + len - 4) << 32) | _wyr4(p + len - 4 - ((len >> 3) << 2)); }
-					else if (_likely_(len > 0)) { a = _wyr3(p, len); b = 0; }
-					else a = b = 0;
-				}
-				else {
-					size_t i = len;
-					if (_unlikely_(i > 48)) {
-						uint64_t see1 = seed, see2 = seed;
-						do {
-							seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);
-							see1 = _wymix(_wyr8(p + 16) ^ secret[2], _wyr8(p + 24) ^ see1);
-							see2 = _wymix(_wyr8(p + 32) ^ secret[3], _wyr8(p + 40) ^ see2);
-							p += 48; i -= 48;
-						} while (_likely_(i > 48));
-						seed ^= see1 ^ see2;
-					}
-					while (_unlikely_(i > 16)) { seed = _wymix(_wyr8(p) ^ secret[1], _wyr8(p + 8) ^ seed);  i -= 16; p += 16; }
-					a = _wyr8(p + i - 16);  b = _wyr8(p + i - 8);
-				}
-				return _wymix(secret[1] ^ len, _wymix(a ^ secret[1], b ^ seed));
+				uint8_t& reg = registers[hash >> (64 - PRECISION)];
+				uint8_t rank = dense_rank(hash);
+				reg = reg > rank ? reg : rank;
+			}
+			else
+				add_sparse(static_cast<uint32_t>(hash >> (64 - sparse_precision)), sparse_rank(hash));
+		}
+#ifdef __cpp_lib_span
+		/// <summary>
+		/// Add many keys. The keys are hashed by groups, without dependencies between them.
+		/// </summary>
+		void add(std::span<const T> keys)
+		{
+			uint64_t hashes[batch_size];
+			for (size_t start = 0; start < keys.size(); start += batch_size)
+			{
+				size_t count = keys.size() - start < batch_size ? keys.size() - start : batch_size;
+				for (size_t i = 0; i < count; i++)
+					hashes[i] = static_cast<uint64_t>(hash_function_(keys[start + i]));
+				for (size_t i = 0; i < count; i++)
+					add_hash(hashes[i]);
+			}
+		}
+#endif
 
+		/// <summary>
+		/// Add the keys of other sketch
+		/// </summary>
+		void merge(const hyperloglog& other)
+		{
+			if (other.registers.empty())
+			{
+				for (const auto& entry : other.sparse)
+					add_sparse(entry.first, entry.second);
 			}
-			/// <summary>
-			/// Hash a 64-bit number
-			/// </summary>
-			/// <param name="number">The number to hash</param>
-			/// <returns>A 64-bits hash</returns>
-			forceinline uint64_t wyhash(uint64_t number) const noexcept
+			else
 			{
-				return internal::wyhash64(number, secret[0]);
+				if (registers.empty()) to_dense();
+				internal::_wymax_u8(registers.data(), other.registers.data(), num_registers);
 			}
-		};
+		}
 
 		/// <summary>
-		/// Hash base class for string types
+		/// Estimate the number of distinct keys added
 		/// </summary>
-		/// <typeparam name="STRING_TYPE">The type of the string, ex: std::string, std::wstring, ...</typeparam>
-		template<class STRING_TYPE> struct hash_string_base : private hash_imp
+		double estimate() const noexcept
 		{
-			using hash_imp::hash_imp;// Inherit constructors
-			forceinline uint64_t operator()(const STRING_TYPE& elem) const noexcept
+			if (registers.empty())
 			{
-				return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(elem.data()), sizeof(typename STRING_TYPE::value_type) * elem.size());
+				// Linear counting with the sparse precision
+				double m = static_cast<double>(uint64_t(1) << sparse_precision);
+				return m * std::log(m / (m - static_cast<double>(sparse.size())));
 			}
-		};
-	};
 
-	/// <summary>
-	/// Common wyhash for general use
-	/// </summary>
-	/// <typeparam name="T">Type of the element to hash</typeparam>
-	template<class T> struct hash : private internal::hash_imp
-	{
-		using hash_imp::hash_imp;// Inherit constructors
+			// Improved estimator from "New cardinality estimation algorithms for HyperLogLog sketches", Otmar Ertl 2017
+			constexpr uint32_t q = 64 - PRECISION;
+			uint32_t histogram[q + 2] = {};
+			for (uint8_t reg : registers)
+				histogram[reg]++;
+
+			double m = static_cast<double>(num_registers);
+			double z = m * tau(1 - histogram[q + 1] / m);
+			for (uint32_t k = q; k >= 1; k--)
+				z = 0.5 * (z + histogram[k]);
+			z += m * sigma(histogram[0] / m);
+			return m * m / (2 * 0.69314718055994530942 * z);
+		}
 
 		/// <summary>
-		/// Hash a general type
+		/// Remove all the keys
 		/// </summary>
-		/// <param name="elem">The element to hash</param>
-		/// <returns>A 64-bits hash</returns>
-        forceinline uint64_t operator()(const T& elem) const noexcept
-        {
-            static_assert(sizeof(T) > 0, "Type to hash T should have variables");
+		void clear() noexcept { registers.clear(); registers.shrink_to_fit(); sparse.clear(); }
 
-			if (sizeof(T) ==  4) return hash_imp::wyhash(internal::_wyr4(&elem));
-            if (sizeof(T) ==  8) return hash_imp::wyhash(internal::_wyr8(&elem));
-			if (sizeof(T) == 16) return internal::wyhash64(internal::_wyr8(&elem), internal::_wyr8(reinterpret_cast<const uint8_t*>(&elem) + 8));
+		bool is_sparse() const noexcept { return registers.empty(); }
+		HASH hash_function() const { return hash_function_; }
 
-            return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(&elem), sizeof(T));
-        }
+	private:
+		static constexpr uint32_t sparse_precision = 25;
+		static constexpr size_t batch_size = 16;// Keys hashed ahead on the batch add
+
+		std::vector<uint8_t> registers;// Dense registers, empty while sparse
+		wy::flat_map<uint32_t, uint8_t> sparse;// Sparse registers with 'sparse_precision' bits of index
+		HASH hash_function_;
+
+		static forceinline uint8_t dense_rank(uint64_t hash) noexcept
+		{
+			// Position of the first 1 after the index bits, the guard bit limits it to 64 - PRECISION + 1
+			return static_cast<uint8_t>(internal::_wyclz((hash << PRECISION) | (uint64_t(1) << (PRECISION - 1))) + 1);
+		}
+		static forceinline uint8_t sparse_rank(uint64_t hash) noexcept
+		{
+			return static_cast<uint8_t>(internal::_wyclz((hash << sparse_precision) | (uint64_t(1) << (sparse_precision - 1))) + 1);
+		}
+		void add_sparse(uint32_t index, uint8_t rank)
+		{
+			if (!registers.empty()) { add_dense_from_sparse(index, rank); return; }
+
+			auto result = sparse.try_emplace(index, rank);
+			if (!result.second && result.first->second < rank) result.first->second = rank;
+			// A sparse entry uses ~8 bytes: change to dense when that is smaller
+			if (sparse.size() > num_registers / 8) to_dense();
+		}
+		forceinline void add_dense_from_sparse(uint32_t index, uint8_t rank) noexcept
+		{
+			// The sparse index has the 'sparse_precision - PRECISION' bits after the dense index
+			constexpr uint32_t extra_bits = sparse_precision - PRECISION;
+			uint32_t extra = index & ((1u << extra_bits) - 1);
+			uint8_t dense = extra ? static_cast<uint8_t>(internal::_wyclz(uint64_t(extra) << (64 - extra_bits)) + 1) : static_cast<uint8_t>(extra_bits + rank);
+			uint8_t& reg = registers[index >> extra_bits];
+			reg = reg > dense ? reg : dense;
+		}
+		void to_dense()
+		{
+			registers.assign(num_registers, 0);
+			for (const auto& entry : sparse)
+				add_dense_from_sparse(entry.first, entry.second);
+			sparse = wy::flat_map<uint32_t, uint8_t>();
+		}
+
+		static double sigma(double x) noexcept
+		{
+			if (x == 1) return INFINITY;
+			double y = 1, z = x, z_old;
+			do {
+				x *= x;
+				z_old = z;
+				z += x * y;
+				y += y;
+			} while (z != z_old);
+			return z;
+		}
+		static double tau(double x) noexcept
+		{
+			if (x == 0 || x == 1) return 0;
+			double y = 1, z = 1 - x, z_old;
+			do {
+				x = std::sqrt(x);
+				z_old = z;
+				y *= 0.5;
+				z -= (1 - x) * (1 - x) * y;
+			} while (z != z_old);
+			return z / 3;
+		}
 	};
+
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Consistent hashing
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	/// <summary>
-	/// Partial specialization for pointer
+	/// Jump consistent hash (Lamping and Veach) driven by wyrand: maps a key to [0, buckets) so that going from n to n+1
+	/// buckets only moves 1/(n+1) of the keys, all to the new bucket. O(log(buckets)) time without memory.
+	/// Buckets can only be added or removed at the end, use 'rendezvous_router' for arbitrary nodes.
 	/// </summary>
-	/// <typeparam name="T">Type of elements</typeparam>
-	template<class T> struct hash<T*> : private internal::hash_imp
+	/// <param name="key">The hash of the key, for example from wy::hash</param>
+	/// <param name="buckets">The number of buckets, greater than 0</param>
+	/// <returns>The bucket of the key</returns>
+	inline int32_t jump_hash(uint64_t key, int32_t buckets) noexcept
 	{
-		using hash_imp::hash_imp;// Inherit constructors
-		forceinline uint64_t operator()(const T* elem) const noexcept
+		assert(buckets > 0);
+
+		int64_t b = -1, j = 0;
+		while (j < buckets)
 		{
-			static_assert(sizeof(T) > 0, "Type to hash T should have variables");
-			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(elem), sizeof(T));
+			b = j;
+			// Jump to the next bucket where the key would move: (b + 1) / u with u uniform on (0, 1]
+			double u = static_cast<double>((internal::wyrand(&key) >> 11) + 1) * (1.0 / (1ull << 53));
+			double next = static_cast<double>(b + 1) / u;
+			if (next >= static_cast<double>(buckets)) break;// Before the cast: the quotient can be out of int64_t range
+			j = static_cast<int64_t>(next);
 		}
-	};
+		return static_cast<int32_t>(b);
+	}
 
-	// Partial specializations: std::vector
-	template<class T> struct hash<std::vector<T>> :private internal::hash_imp
+	/// <summary>
+	/// Weighted rendezvous (highest random weight) router: each key goes to the node with the highest score, mixing
+	/// the key and node hashes with wyhash64. Adding or removing a node only moves the keys of that node, and nodes
+	/// receive keys proportionally to their weights. A lookup is O(nodes), without the log() when all weights are equal.
+	/// </summary>
+	/// <typeparam name="NODE">The type of the node identifiers</typeparam>
+	/// <typeparam name="HASH">The hash function for the node identifiers</typeparam>
+	template<class NODE = std::string, class HASH = wy::hash<NODE>> class rendezvous_router
 	{
-		using hash_imp::hash_imp;// Inherit constructors
-		forceinline uint64_t operator()(const std::vector<T>& elem) const noexcept
+	public:
+		rendezvous_router(const HASH& hash = HASH()) : hash_function_(hash) {}
+
+		/// <summary>
+		/// Add a node, or change its weight if already present
+		/// </summary>
+		/// <param name="node">The node identifier</param>
+		/// <param name="weight">The relative amount of keys for the node, greater than 0</param>
+		void add(const NODE& node, double weight = 1.0)
 		{
-			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(elem.data()), elem.size() * sizeof(T));
+			assert(weight > 0);
+			uint64_t node_hash = static_cast<uint64_t>(hash_function_(node));
+			size_t i = 0;
+			for (; i < nodes.size() && !(nodes[i].hash == node_hash && nodes[i].id == node); i++);
+			if (i == nodes.size())
+				nodes.push_back({ node, node_hash, weight });
+			else
+				nodes[i].weight = weight;
+			update_equal_weights();
 		}
-	};
-
-	// C strings
-	template<> struct hash<char*> : private internal::hash_imp
-	{
-		using hash_imp::hash_imp;// Inherit constructors
-		forceinline uint64_t operator()(const char* data) const noexcept
+		/// <summary>
+		/// Remove a node
+		/// </summary>
+		/// <returns>True if the node was present</returns>
+		bool remove(const NODE& node)
 		{
-			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+			uint64_t node_hash = static_cast<uint64_t>(hash_function_(node));
+			for (size_t i = 0; i < nodes.size(); i++)
+				if (nodes[i].hash == node_hash && nodes[i].id == node)
+				{
+					nodes.erase(nodes.begin() + static_cast<ptrdiff_t>(i));
+					update_equal_weights();
+					return true;
+				}
+			return false;
 		}
-	};
-	template<> struct hash<const char*> : private internal::hash_imp
-	{
-		using hash_imp::hash_imp;// Inherit constructors
-		forceinline uint64_t operator()(const char* data) const noexcept
+
+		/// <summary>
+		/// Find the node of a key. There should be at least one node.
+		/// </summary>
+		/// <param name="key">The hash of the key, for example from wy::hash</param>
+		/// <returns>The node identifier</returns>
+		const NODE& route(uint64_t key) const noexcept { return nodes[route_index(key)].id; }
+		/// <summary>
+		/// Find the index of the node of a key, on the order the nodes were added. There should be at least one node.
+		/// </summary>
+		size_t route_index(uint64_t key) const noexcept
 		{
-			return hash_imp::wyhash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+			assert(!nodes.empty());
+
+			size_t best = 0;
+			if (equal_weights)
+			{
+				uint64_t best_score = internal::wyhash64(key, nodes[0].hash);
+				for (size_t i = 1; i < nodes.size(); i++)
+				{
+					uint64_t score = internal::wyhash64(key, nodes[i].hash);
+					if (score > best_score) { best_score = score; best = i; }
+				}
+			}
+			else
+			{
+				double best_score = score(key, nodes[0]);
+				for (size_t i = 1; i < nodes.size(); i++)
+				{
+					double node_score = score(key, nodes[i]);
+					if (node_score > best_score) { best_score = node_score; best = i; }
+				}
+			}
+			return best;
 		}
-	};
 
-	// Partial specializations: std::string variants
-	template<> struct hash<std::string> : public internal::hash_string_base<std::string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::wstring> : public internal::hash_string_base<std::wstring>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::u16string> : public internal::hash_string_base<std::u16string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::u32string> : public internal::hash_string_base<std::u32string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	
-	// std::string_view variants
-#if __cpp_lib_string_view
-	template<> struct hash<std::string_view> : public internal::hash_string_base<std::string_view>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::wstring_view> : public internal::hash_string_base<std::wstring_view>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::u16string_view> : public internal::hash_string_base<std::u16string_view>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::u32string_view> : public internal::hash_string_base<std::u32string_view>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-#endif
+		size_t size() const noexcept { return nodes.size(); }
+		bool empty() const noexcept { return nodes.empty(); }
+		const NODE& node(size_t index) const noexcept { return nodes[index].id; }
+		double weight(size_t index) const noexcept { return nodes[index].weight; }
 
-	// std::pmr::string variants
-#if __cpp_lib_polymorphic_allocator
-	template<> struct hash<std::pmr::string> : public internal::hash_string_base<std::pmr::string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::pmr::wstring> : public internal::hash_string_base<std::pmr::wstring>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::pmr::u16string> : public internal::hash_string_base<std::pmr::u16string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::pmr::u32string> : public internal::hash_string_base<std::pmr::u32string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-#endif
+	private:
+		struct node_entry
+		{
+			NODE id;
+			uint64_t hash;
+			double weight;
+		};
+		std::vector<node_entry> nodes;
+		bool equal_weights = true;
+		HASH hash_function_;
 
-	// char8_t string variants
-#if __cpp_char8_t
-	template<> struct hash<std::u8string> : public internal::hash_string_base<std::u8string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::u8string_view> : public internal::hash_string_base<std::u8string_view>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
-	};
-	template<> struct hash<std::pmr::u8string> : public internal::hash_string_base<std::pmr::u8string>
-	{
-		using hash_string_base::hash_string_base;// Inherit constructors
+		void update_equal_weights() noexcept
+		{
+			equal_weights = true;
+			for (const auto& n : nodes)
+				equal_weights &= n.weight == nodes[0].weight;
+		}
+		static forceinline double score(uint64_t key, const node_entry& n) noexcept
+		{
+			// -weight / ln(u) with u uniform on (0, 1): the max is on each node with probability weight / total_weight
+			double u = (static_cast<double>(internal::wyhash64(key, n.hash) >> 11) + 0.5) * (1.0 / (1ull << 53));
+			return -n.weight / std::log(u);
+		}
 	};
-#endif
-};
+};
\ No newline at end of file